@@ -22,476 +22,4259 @@
  * SOFTWARE.
  */
 
+#ifdef __linux__
+
+/* for memfd_create(). */
+#define _GNU_SOURCE
+
+#endif
+
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#endif
+
+#include "bytestream.h"
+
+#ifdef BSTM_FD_IO
+
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#endif
+
+#if defined(BSTM_MPSC) && (defined(__unix__) || defined(__APPLE__))
+
+#include <sched.h>
+
+#endif
+
+#ifdef BSTM_NOTIFY
+
+#include <sys/eventfd.h>
+
+#endif
+
+#ifdef BSTM_WAIT
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#endif
+
+#if !defined(BSTM_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+/* scan for EOL with SSE2/AVX2, picked at runtime. */
+#define BSTM_SIMD_X86
+
+#include <immintrin.h>
+
+#endif
+
+/* where the memory of a byte stream comes from. */
+enum _bstm_store {
+
+    /* context allocated by bstm_new() with the ring buffer trailing it. */
+    BSTM_STORE_HEAP     = 0,
+
+    /* context allocated and mirrored ring buffer mapped by bstm_new(). */
+    BSTM_STORE_MIRROR   = 1,
+
+    /* caller-owned memory given to bstm_init(). */
+    BSTM_STORE_CALLER   = 2,
+
+    /* context and ring buffer allocated apart by bstm_new(), so the buffer
+       can be reallocated. */
+    BSTM_STORE_GROW     = 3,
+
+    /* context allocated by bstm_new(), data kept in pool segments. */
+    BSTM_STORE_CHAIN    = 4,
+
+    /* context allocated by bstm_new(), ring buffer borrowed from a pool
+       while there is data. */
+    BSTM_STORE_POOL     = 5,
+};
+
+/* segment of a byte stream in chain mode, its data trails it. */
+typedef struct _bstm_seg {
+
+    /* next segment in the chain. */
+    struct _bstm_seg *next;
+
+    /* offset of the first byte of data. */
+    bstm_u32_t head;
+
+    /* offset past the last byte of data. */
+    bstm_u32_t tail;
+
+    /* index of the segment in its pool. */
+    bstm_u32_t idx;
+
+    /* index of the next free segment plus 1, 0 ends the free list. */
+    bstm_u32_t free_next;
+} bstm_seg_t;
+
+/* data of a segment. */
+#define BSTM_SEG_DATA(seg)  ((bstm_u8_t *)((seg) + 1))
+
+#ifndef BSTM_POOL_LISTS
+
+/* number of free lists in a pool, each thread sticks to one of them. */
+#define BSTM_POOL_LISTS     16
+
+#endif
+
+/* maximum number of slabs in a pool. */
+#define BSTM_POOL_MAX_SLABS 16384
+
+/* preferred slab size. */
+#define BSTM_POOL_SLAB_SIZE 65536u
+
+/* free list of a pool. */
+typedef struct _bstm_free_list {
+
+    /* index of the first free segment plus 1 in the low half, and a tag
+       bumped on every update in the high half, so a stale head never
+       compares equal. */
+    uint64_t head;
+
+    /* keep the other free lists off this cache line. */
+    bstm_u8_t pad[BSTM_CACHE_LINE_SIZE - sizeof(uint64_t)];
+} bstm_free_list_t;
+
+/* pool of fixed-size segments, allocated in slabs and never freed before
+   the pool. */
+typedef struct _bstm_pool {
+
+    /* data size of a segment. */
+    bstm_u32_t seg_size;
+
+    /* distance between two segments in a slab. */
+    bstm_u32_t seg_stride;
+
+    /* log2 of the number of segments in a slab. */
+    bstm_u32_t slab_shift;
+
+    /* number of slabs claimed. */
+    bstm_u32_t slab_cnt;
+
+    /* slabs, indexed by the high bits of the segment index. */
+    bstm_u8_t *slab[BSTM_POOL_MAX_SLABS];
+
+    /* free lists. */
+    bstm_free_list_t free_list[BSTM_POOL_LISTS];
+} bstm_pool_t;
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define BSTM_THREAD_LOCAL   _Thread_local
+#else
+#define BSTM_THREAD_LOCAL   __thread
+#endif
+
+/* free list of the calling thread plus 1, 0 until it's picked. */
+static BSTM_THREAD_LOCAL bstm_u32_t bstm_thread_list;
+
+/* free list picked by the next thread. */
+static bstm_u32_t bstm_next_list;
+
+#ifdef BSTM_NOTIFY
+
+/* side of the readiness notification, BSTM_NOTIFY_XXX. */
+enum _bstm_notify_dir {
+
+    /* consumer, ready when the used size reaches the mark. */
+    BSTM_NOTIFY_READ    = 0,
+
+    /* producer, ready when the free size reaches the mark. */
+    BSTM_NOTIFY_WRITE   = 1,
+};
+
+/* eventfd posted when one side of the byte stream becomes ready. */
+typedef struct _bstm_notify_side {
+
+    /* eventfd. */
+    int fd;
+
+    /* size the side is ready at. */
+    bstm_size_t mark;
+
+    /* non-zero until the eventfd is posted, the side rearms it once it's no
+       longer ready. */
+    bstm_u32_t armed;
+} bstm_notify_side_t;
+
+/* readiness notification of a byte stream. */
+typedef struct _bstm_notify {
+
+    /* sides, indexed by BSTM_NOTIFY_XXX. */
+    bstm_notify_side_t side[2];
+} bstm_notify_t;
+
+#endif
+
+/* read position of a reader. */
+typedef struct _bstm_reader {
+
+    /* head byte index of the reader, owned by it. */
+    bstm_size_t head_idx;
+
+    /* size of the data after the head already scanned without finding EOL. */
+    bstm_size_t scan_size;
+
+    /* non-zero while the reader holds the data back. */
+    bstm_u32_t attached;
+
+#ifdef BSTM_SPSC
+
+    /* tail byte index last observed by the reader. */
+    bstm_size_t tail_seen;
+
+    /* keep each reader on its own cache line. */
+    bstm_u8_t end_pad[BSTM_CACHE_LINE_SIZE];
+
+#endif
+} bstm_reader_t;
+
+/* context of the byte stream. */
+typedef struct _bstm_ctx {
+
+    /* ring buffer. */
+    bstm_u8_t *ring_buff;
+
+    /* size of the ring buffer. */
+    bstm_size_t buff_size;
+
+    /* size of the memory addressable contiguously from the ring buffer,
+       twice the buffer size if it's mirrored. */
+    bstm_size_t map_size;
+
+    /* index mask if the buffer size is a power of two, otherwise 0. */
+    bstm_size_t idx_mask;
+
+    /* where the memory comes from, BSTM_STORE_XXX. */
+    bstm_u32_t store;
+
+    /* configuration. */
+    struct _bstm_ctx_conf {
+
+        /* capacity of the byte stream. */
+        bstm_size_t cap_size;
+
+        /* configuration flags. */
+        bstm_u32_t flags;
+
+        /* initial capacity of a growable byte stream. */
+        bstm_size_t init_size;
+
+        /* maximum capacity of a growable byte stream. */
+        bstm_size_t max_size;
+
+        /* capacity multiplier of a growable byte stream. */
+        bstm_u32_t grow_factor;
+
+        /* milliseconds an empty lazy byte stream keeps its buffer. */
+        bstm_u32_t idle_time;
+    } conf;
+
+    /* time in milliseconds a lazy byte stream became empty at. */
+    bstm_u32_t idle_since;
+
+    /* size of the data dropped by overwriting so far. */
+    bstm_u64_t drop_size;
+
+#ifndef BSTM_SPSC
+
+    /* watermarks. */
+    struct _bstm_ctx_mark {
+
+        /* callback. */
+        bstm_mark_cb_t cb;
+
+        /* argument of the callback. */
+        void *arg;
+
+        /* high watermark. */
+        bstm_size_t high;
+
+        /* low watermark. */
+        bstm_size_t low;
+
+        /* the callback is called once the used size reaches it, the high
+           watermark while below it, out of reach otherwise. */
+        bstm_size_t high_trip;
+
+        /* the callback is called once the used size falls below it, the low
+           watermark plus 1 while above the high one, 0 otherwise. */
+        bstm_size_t low_trip;
+    } mark;
+
+#endif
+
+    /* segment chain in chain mode, only the pool is used in pool mode. */
+    struct _bstm_chain {
+
+        /* pool the segments come from. */
+        bstm_pool_t *pool;
+
+        /* first segment, holding the head. */
+        bstm_seg_t *first;
+
+        /* segment holding the tail, followed by spare segments only. */
+        bstm_seg_t *last;
+    } chain;
+
+    /* readers, the head index follows the slowest one. */
+    bstm_reader_t *reader;
+
+    /* number of readers. */
+    bstm_u32_t reader_cnt;
+
+#ifdef BSTM_NOTIFY
+
+    /* readiness notification, NULL unless opened. */
+    bstm_notify_t *notify;
+
+#endif
+
+#ifdef BSTM_WAIT
+
+    /* sides parked on a futex, BSTM_WAITER_XXX. */
+    bstm_u32_t waiters;
+
+#endif
+
+#ifdef BSTM_SPSC
+
+    /* keep the consumer's fields off the read-mostly cache line above. */
+    bstm_u8_t cons_pad[BSTM_CACHE_LINE_SIZE];
+
+    /* head byte index, owned by the consumer. */
+    bstm_size_t head_idx;
+
+    /* tail byte index last observed by the consumer. */
+    bstm_size_t tail_seen;
+
+    /* size of the data after the head already scanned without finding EOL. */
+    bstm_size_t scan_size;
+
+#ifdef BSTM_WAIT
+
+    /* spins of a waiting consumer before it parks. */
+    bstm_u32_t read_spin;
+
+#endif
+
+    /* keep the producer's fields off the consumer's cache line. */
+    bstm_u8_t prod_pad[BSTM_CACHE_LINE_SIZE];
+
+    /* tail byte index, owned by the producer. */
+    bstm_size_t tail_idx;
+
+    /* head byte index last observed by the producer. */
+    bstm_size_t head_seen;
+
+#ifdef BSTM_WAIT
+
+    /* spins of a waiting producer before it parks. */
+    bstm_u32_t write_spin;
+
+#endif
+
+#ifdef BSTM_MPSC
+
+    /* keep the claim index, hit by every producer, off the tail index. */
+    bstm_u8_t claim_pad[BSTM_CACHE_LINE_SIZE];
+
+    /* end of the space claimed by the producers, the tail index follows it
+       as the claimed ranges are published. */
+    bstm_size_t claim_idx;
+
+#endif
+
+    /* keep the producer's fields off whatever follows the context. */
+    bstm_u8_t end_pad[BSTM_CACHE_LINE_SIZE];
+
+#else
+
+    /* head byte index. */
+    bstm_size_t head_idx;
+
+    /* tail byte index. */
+    bstm_size_t tail_idx;
+
+    /* size of the data after the head already scanned without finding EOL. */
+    bstm_size_t scan_size;
+
+#endif
+} bstm_ctx_t;
+
+/* make sure BSTM_CTX_SIZE can hold a context. */
+typedef char bstm_ctx_size_check[sizeof(bstm_ctx_t) <= BSTM_CTX_SIZE ? 1 : -1];
+
+#ifdef BSTM_SPSC
+
+/* load an index published by the other side. */
+#define BSTM_LOAD_ACQUIRE(ptr)          __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+
+/* publish an index to the other side. */
+#define BSTM_STORE_RELEASE(ptr, val)    __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+
+#else
+
+#define BSTM_LOAD_ACQUIRE(ptr)          (*(ptr))
+
+#define BSTM_STORE_RELEASE(ptr, val)    (*(ptr) = (val))
+
+#endif
+
+/* tell the CPU it's spinning. */
+#if defined(__x86_64__) || defined(__i386__)
+#define BSTM_CPU_RELAX()                __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define BSTM_CPU_RELAX()                __asm__ __volatile__("yield")
+#else
+#define BSTM_CPU_RELAX()                ((void)0)
+#endif
+
+/* spins before a waiting producer lets other threads run. */
+#define BSTM_SPIN_LIMIT                 128
+
+#ifdef BSTM_WAIT
+
+/* consumer parked on the tail index. */
+#define BSTM_WAITER_READ                (1u << 0)
+
+/* producer parked on the head index. */
+#define BSTM_WAITER_WRITE               (1u << 1)
+
+/* bounds of the spins before a waiter parks, adapted to how often spinning
+   pays off. */
+#define BSTM_WAIT_SPIN_MIN              16
+#define BSTM_WAIT_SPIN_MAX              4096
+
+#endif
+
+/**
+ * @brief get the buffer offset of an index.
+ * 
+ * @note with a power of two buffer size, indexes run freely and are masked,
+ *       otherwise they are kept below the buffer size.
+ * 
+ * @param ctx context pointer.
+ * @param idx byte index.
+*/
+static bstm_size_t bstm_offs(bstm_ctx_t *ctx, bstm_size_t idx) {
+    if (ctx->idx_mask != 0) {
+        return idx & ctx->idx_mask;
+    }
+
+    return idx;
+}
+
+/**
+ * @brief move an index forward along the ring.
+ * 
+ * @param ctx context pointer.
+ * @param idx byte index.
+ * @param size distance to move, not larger than the buffer size.
+*/
+static bstm_size_t bstm_next(bstm_ctx_t *ctx, bstm_size_t idx, bstm_size_t size) {
+    idx += size;
+    if (ctx->idx_mask == 0 &&
+        idx >= ctx->buff_size) {
+        idx -= ctx->buff_size;
+    }
+
+    return idx;
+}
+
+/**
+ * @brief get the distance from one index to another along the ring.
+ * 
+ * @param ctx context pointer.
+ * @param from start index.
+ * @param to end index.
+*/
+static bstm_size_t bstm_dist(bstm_ctx_t *ctx, bstm_size_t from, bstm_size_t to) {
+    if (ctx->idx_mask != 0 ||
+        to >= from) {
+        return to - from;
+    }
+
+    return to + ctx->buff_size - from;
+}
+
+/**
+ * @brief get the used size seen from the consumer side.
+ * 
+ * @note in SPSC mode the producer's tail index is only reloaded when the
+ *       last observed one doesn't already cover the requested size.
+ * 
+ * @param ctx context pointer.
+ * @param need size the caller is interested in.
+*/
+static bstm_size_t bstm_used_size(bstm_ctx_t *ctx, bstm_size_t need) {
+#ifdef BSTM_SPSC
+    bstm_size_t used_size;
+
+    used_size = bstm_dist(ctx, ctx->head_idx, ctx->tail_seen);
+    if (used_size < need) {
+        ctx->tail_seen = BSTM_LOAD_ACQUIRE(&ctx->tail_idx);
+        used_size = bstm_dist(ctx, ctx->head_idx, ctx->tail_seen);
+    }
+
+    return used_size;
+#else
+    (void)need;
+
+    return bstm_dist(ctx, ctx->head_idx, ctx->tail_idx);
+#endif
+}
+
+/**
+ * @brief get the free size seen from the producer side.
+ * 
+ * @note in SPSC mode the consumer's head index is only reloaded when the
+ *       last observed one doesn't already leave the requested size free.
+ * 
+ * @param ctx context pointer.
+ * @param need size the caller is interested in.
+*/
+static bstm_size_t bstm_free_size(bstm_ctx_t *ctx, bstm_size_t need) {
+#if defined(BSTM_MPSC)
+    (void)need;
+
+    /* other producers move the tail past what a cached head allows for. */
+    return ctx->conf.cap_size - bstm_dist(ctx, BSTM_LOAD_ACQUIRE(&ctx->head_idx), ctx->tail_idx);
+#elif defined(BSTM_SPSC)
+    bstm_size_t free_size;
+
+    free_size = ctx->conf.cap_size - bstm_dist(ctx, ctx->head_seen, ctx->tail_idx);
+    if (free_size < need) {
+        ctx->head_seen = BSTM_LOAD_ACQUIRE(&ctx->head_idx);
+        free_size = ctx->conf.cap_size - bstm_dist(ctx, ctx->head_seen, ctx->tail_idx);
+    }
+
+    return free_size;
+#else
+    (void)need;
+
+    return ctx->conf.cap_size - bstm_dist(ctx, ctx->head_idx, ctx->tail_idx);
+#endif
+}
+
+#ifndef BSTM_MPSC
+
+/**
+ * @brief get a segment of the pool by its index.
+ * 
+ * @param pool pool pointer.
+ * @param idx segment index.
+*/
+static bstm_seg_t *bstm_pool_seg(bstm_pool_t *pool, bstm_u32_t idx) {
+    bstm_u8_t *slab;
+
+    slab = __atomic_load_n(&pool->slab[idx >> pool->slab_shift], __ATOMIC_ACQUIRE);
+
+    return (bstm_seg_t *)(slab + (size_t)(idx & ((1u << pool->slab_shift) - 1)) * pool->seg_stride);
+}
+
+#endif
+
+/**
+ * @brief get the free list of the calling thread.
+ * 
+ * @param pool pool pointer.
+*/
+static bstm_free_list_t *bstm_pool_list(bstm_pool_t *pool) {
+    if (bstm_thread_list == 0) {
+        bstm_thread_list = __atomic_fetch_add(&bstm_next_list, 1, __ATOMIC_RELAXED) % BSTM_POOL_LISTS + 1;
+    }
+
+    return &pool->free_list[bstm_thread_list - 1];
+}
+
+/**
+ * @brief push linked segments onto a free list.
+ * 
+ * @param list free list pointer.
+ * @param first first segment.
+ * @param last last segment, linked from first through free_next.
+*/
+static void bstm_free_push(bstm_free_list_t *list, bstm_seg_t *first, bstm_seg_t *last) {
+    uint64_t old_head;
+    uint64_t new_head;
+
+    old_head = __atomic_load_n(&list->head, __ATOMIC_RELAXED);
+    do {
+        __atomic_store_n(&last->free_next, (bstm_u32_t)old_head, __ATOMIC_RELAXED);
+        new_head = (((old_head >> 32) + 1) << 32) | (first->idx + 1);
+    } while (!__atomic_compare_exchange_n(&list->head, &old_head, new_head, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+#ifndef BSTM_MPSC
+
+/**
+ * @brief pop a segment from a free list.
+ * 
+ * @note the next index read from a segment popped by another thread in the
+ *       meantime may be garbage, but then the tag has moved on and the
+ *       exchange fails.
+ * 
+ * @param pool pool pointer.
+ * @param list free list pointer.
+ * 
+ * @return a free segment, or NULL if the list is empty.
+*/
+static bstm_seg_t *bstm_free_pop(bstm_pool_t *pool, bstm_free_list_t *list) {
+    uint64_t old_head;
+    uint64_t new_head;
+    bstm_seg_t *seg;
+
+    old_head = __atomic_load_n(&list->head, __ATOMIC_ACQUIRE);
+    do {
+        if ((bstm_u32_t)old_head == 0) {
+            return NULL;
+        }
+
+        seg = bstm_pool_seg(pool, (bstm_u32_t)old_head - 1);
+        new_head = (((old_head >> 32) + 1) << 32) |
+            __atomic_load_n(&seg->free_next, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&list->head, &old_head, new_head, 1,
+        __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return seg;
+}
+
+/**
+ * @brief allocate a slab, keep its first segment and free the others.
+ * 
+ * @param pool pool pointer.
+ * @param list free list of the calling thread.
+ * 
+ * @return a segment, or NULL on failure.
+*/
+static bstm_seg_t *bstm_slab_alloc(bstm_pool_t *pool, bstm_free_list_t *list) {
+    bstm_u32_t slab_segs;
+    bstm_u32_t slab_idx;
+    bstm_u8_t *slab;
+    bstm_seg_t *seg;
+    bstm_u32_t i;
+
+    slab_idx = __atomic_fetch_add(&pool->slab_cnt, 1, __ATOMIC_RELAXED);
+    if (slab_idx >= BSTM_POOL_MAX_SLABS) {
+        return NULL;
+    }
+
+    slab_segs = 1u << pool->slab_shift;
+    slab = (bstm_u8_t *)malloc((size_t)slab_segs * pool->seg_stride);
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < slab_segs; i++) {
+        seg = (bstm_seg_t *)(slab + (size_t)i * pool->seg_stride);
+        seg->idx = (slab_idx << pool->slab_shift) | i;
+        seg->free_next = seg->idx + 2;
+    }
+
+    /* publish the slab before any of its segments can be found. */
+    __atomic_store_n(&pool->slab[slab_idx], slab, __ATOMIC_RELEASE);
+
+    if (slab_segs > 1) {
+        bstm_free_push(list, (bstm_seg_t *)(slab + pool->seg_stride),
+            (bstm_seg_t *)(slab + (size_t)(slab_segs - 1) * pool->seg_stride));
+    }
+
+    return (bstm_seg_t *)slab;
+}
+
+/**
+ * @brief take a segment from the pool.
+ * 
+ * @note the free list of the calling thread is tried first, then the ones
+ *       of the other threads, and a new slab is allocated last.
+ * 
+ * @param pool pool pointer.
+ * 
+ * @return an empty segment, or NULL on failure.
+*/
+static bstm_seg_t *bstm_seg_get(bstm_pool_t *pool) {
+    bstm_free_list_t *list;
+    bstm_seg_t *seg;
+    bstm_u32_t i;
+
+    list = bstm_pool_list(pool);
+    seg = NULL;
+    for (i = 0; i < BSTM_POOL_LISTS && seg == NULL; i++) {
+        seg = bstm_free_pop(pool, &pool->free_list[(bstm_thread_list - 1 + i) % BSTM_POOL_LISTS]);
+    }
+
+    if (seg == NULL) {
+        seg = bstm_slab_alloc(pool, list);
+        if (seg == NULL) {
+            return NULL;
+        }
+    }
+
+    seg->next = NULL;
+    seg->head = 0;
+    seg->tail = 0;
+
+    return seg;
+}
+
+#endif
+
+/**
+ * @brief give a segment back to the free list of the calling thread.
+ * 
+ * @param pool pool pointer.
+ * @param seg segment pointer.
+*/
+static void bstm_seg_put(bstm_pool_t *pool, bstm_seg_t *seg) {
+    bstm_free_push(bstm_pool_list(pool), seg, seg);
+}
+
+/**
+ * @brief give the segments read empty at the front of the chain back.
+ * 
+ * @param ctx context pointer.
+*/
+static void bstm_chain_trim(bstm_ctx_t *ctx) {
+    bstm_seg_t *seg;
+
+    while (ctx->chain.first != ctx->chain.last &&
+           ctx->chain.first->head == ctx->chain.first->tail) {
+        seg = ctx->chain.first;
+        ctx->chain.first = seg->next;
+        bstm_seg_put(ctx->chain.pool, seg);
+    }
+}
+
+#ifndef BSTM_MPSC
+
+/**
+ * @brief get the room after the tail, up to a size.
+ * 
+ * @param ctx context pointer.
+ * @param size size the caller is interested in.
+*/
+static bstm_size_t bstm_chain_room(bstm_ctx_t *ctx, bstm_size_t size) {
+    bstm_size_t room_size;
+    bstm_seg_t *seg;
+
+    room_size = 0;
+    for (seg = ctx->chain.last; seg != NULL && room_size < size; seg = seg->next) {
+        room_size += ctx->chain.pool->seg_size - seg->tail;
+    }
+
+    return room_size;
+}
+
+/**
+ * @brief make room for data after the tail, appending spare segments.
+ * 
+ * @param ctx context pointer.
+ * @param size room size required.
+ * 
+ * @return BSTM_OK              make room successfully.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+*/
+static bstm_res_t bstm_chain_extend(bstm_ctx_t *ctx, bstm_size_t size) {
+    bstm_size_t room_size;
+    bstm_seg_t *prev;
+    bstm_seg_t *seg;
+
+    room_size = bstm_chain_room(ctx, size);
+    if (room_size >= size) {
+        return BSTM_OK;
+    }
+
+    for (prev = ctx->chain.last; prev != NULL && prev->next != NULL; prev = prev->next) {
+    }
+
+    while (room_size < size) {
+        seg = bstm_seg_get(ctx->chain.pool);
+        if (seg == NULL) {
+            return BSTM_ERR_NO_MEM;
+        }
+
+        if (prev == NULL) {
+            ctx->chain.first = seg;
+            ctx->chain.last = seg;
+        } else {
+            prev->next = seg;
+        }
+        prev = seg;
+        room_size += ctx->chain.pool->seg_size;
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief copy data into the room after the tail.
+ * 
+ * @param ctx context pointer.
+ * @param data data pointer.
+ * @param size data size, not larger than the room.
+*/
+static void bstm_chain_copy_in(bstm_ctx_t *ctx, const void *data, bstm_size_t size) {
+    bstm_size_t copy_size;
+    bstm_seg_t *seg;
+
+    for (seg = ctx->chain.last; size != 0; seg = seg->next) {
+        copy_size = ctx->chain.pool->seg_size - seg->tail;
+        if (copy_size > size) {
+            copy_size = size;
+        }
+
+        memcpy(BSTM_SEG_DATA(seg) + seg->tail, data, copy_size);
+        data = (const bstm_u8_t *)data + copy_size;
+        size -= copy_size;
+    }
+}
+
+#endif
+
+/**
+ * @brief copy data out of the chain.
+ * 
+ * @param ctx context pointer.
+ * @param data data pointer.
+ * @param offs offset from the head to copy from.
+ * @param size data size.
+*/
+static void bstm_chain_copy_out(bstm_ctx_t *ctx, void *data, bstm_size_t offs, bstm_size_t size) {
+    bstm_size_t copy_size;
+    bstm_seg_t *seg;
+
+    for (seg = ctx->chain.first; size != 0; seg = seg->next) {
+        copy_size = seg->tail - seg->head;
+        if (offs >= copy_size) {
+            offs -= copy_size;
+
+            continue;
+        }
+        copy_size -= offs;
+        if (copy_size > size) {
+            copy_size = size;
+        }
+
+        memcpy(data, BSTM_SEG_DATA(seg) + seg->head + offs, copy_size);
+        data = (bstm_u8_t *)data + copy_size;
+        size -= copy_size;
+        offs = 0;
+    }
+}
+
+/**
+ * @brief move the tail forward through the segments.
+ * 
+ * @param ctx context pointer.
+ * @param size written size, not larger than the room.
+*/
+static void bstm_chain_produce(bstm_ctx_t *ctx, bstm_size_t size) {
+    bstm_size_t room_size;
+    bstm_seg_t *seg;
+
+    seg = ctx->chain.last;
+    while (size != 0) {
+        room_size = ctx->chain.pool->seg_size - seg->tail;
+        if (room_size == 0) {
+            seg = seg->next;
+
+            continue;
+        }
+
+        if (room_size > size) {
+            room_size = size;
+        }
+        seg->tail += (bstm_u32_t)room_size;
+        size -= room_size;
+    }
+    ctx->chain.last = seg;
+
+    /* segments read empty before the tail moved on can go now. */
+    bstm_chain_trim(ctx);
+}
+
+/**
+ * @brief move the head forward through the segments, giving the ones read
+ *        empty back to the pool.
+ * 
+ * @param ctx context pointer.
+ * @param size read size, not larger than the data size.
+*/
+static void bstm_chain_consume(bstm_ctx_t *ctx, bstm_size_t size) {
+    bstm_size_t data_size;
+    bstm_seg_t *seg;
+
+    for (;;) {
+        bstm_chain_trim(ctx);
+        if (size == 0) {
+            break;
+        }
+
+        seg = ctx->chain.first;
+        data_size = seg->tail - seg->head;
+        if (data_size > size) {
+            data_size = size;
+        }
+        seg->head += (bstm_u32_t)data_size;
+        size -= data_size;
+    }
+}
+
+/**
+ * @brief give all the segments of the chain back.
+ * 
+ * @param ctx context pointer.
+*/
+static void bstm_chain_free(bstm_ctx_t *ctx) {
+    bstm_seg_t *seg;
+
+    while (ctx->chain.first != NULL) {
+        seg = ctx->chain.first;
+        ctx->chain.first = seg->next;
+        bstm_seg_put(ctx->chain.pool, seg);
+    }
+    ctx->chain.last = NULL;
+}
+
+/**
+ * @brief copy data out of the ring buffer.
+ * 
+ * @param ctx context pointer.
+ * @param idx byte index to copy from.
+ * @param data data pointer.
+ * @param size data size.
+*/
+static void bstm_copy_at(bstm_ctx_t *ctx, bstm_size_t idx, void *data, bstm_size_t size) {
+    bstm_u8_t *first_copy_ptr;
+    bstm_size_t offs;
+
+    offs = bstm_offs(ctx, idx);
+    first_copy_ptr = ctx->ring_buff + offs;
+    if (ctx->map_size - offs >= size) {
+        memcpy(data, first_copy_ptr, size);
+    } else {
+        bstm_size_t first_copy_size = ctx->buff_size - offs;
+        bstm_size_t second_copy_size = size - first_copy_size;
+
+        memcpy(data, first_copy_ptr, first_copy_size);
+        memcpy((bstm_u8_t *)data + first_copy_size, ctx->ring_buff, second_copy_size);
+    }
+}
+
+/**
+ * @brief copy data out of the byte stream.
+ * 
+ * @param ctx context pointer.
+ * @param data data pointer.
+ * @param offs offset from the head to copy from.
+ * @param size data size.
+*/
+static void bstm_copy_out(bstm_ctx_t *ctx, void *data, bstm_size_t offs, bstm_size_t size) {
+    if (ctx->store == BSTM_STORE_CHAIN) {
+        bstm_chain_copy_out(ctx, data, offs, size);
+
+        return;
+    }
+
+    bstm_copy_at(ctx, bstm_next(ctx, ctx->head_idx, offs), data, size);
+}
+
+/**
+ * @brief copy data into the ring buffer.
+ * 
+ * @param ctx context pointer.
+ * @param idx byte index to copy to.
+ * @param data data pointer.
+ * @param size data size.
+*/
+static void bstm_copy_in(bstm_ctx_t *ctx, bstm_size_t idx, const void *data, bstm_size_t size) {
+    bstm_u8_t *first_copy_ptr;
+    bstm_size_t offs;
+
+    offs = bstm_offs(ctx, idx);
+    first_copy_ptr = ctx->ring_buff + offs;
+    if (ctx->map_size - offs >= size) {
+        memcpy(first_copy_ptr, data, size);
+    } else {
+        bstm_size_t first_copy_size = ctx->buff_size - offs;
+        bstm_size_t second_copy_size = size - first_copy_size;
+
+        memcpy(first_copy_ptr, data, first_copy_size);
+        memcpy(ctx->ring_buff, (const bstm_u8_t *)data + first_copy_size, second_copy_size);
+    }
+}
+
+/* default capacity size. */
+#define BSTM_DEF_CAP_SIZE   1024
+
+/* maximum capacity size with BSTM_CONF_POW2. */
+#if defined(BSTM_SIZE_64) && SIZE_MAX > 0xFFFFFFFFu
+#define BSTM_POW2_MAX_SIZE  0x8000000000000000ull
+#else
+#define BSTM_POW2_MAX_SIZE  0x80000000u
+#endif
+
+/* maximum capacity size otherwise, the buffer size must not wrap to 0, nor
+   outgrow a 32-bit address space with BSTM_SIZE_64. */
+#if defined(BSTM_SIZE_64) && SIZE_MAX > 0xFFFFFFFFu
+#define BSTM_MAX_SIZE       0xFFFFFFFFFFFFFFFEull
+#else
+#define BSTM_MAX_SIZE       0xFFFFFFFEu
+#endif
+
+/* default capacity multiplier of a growable byte stream. */
+#define BSTM_DEF_GROW_FACTOR    2
+
+/**
+ * @brief get the size of a ring buffer holding a capacity.
+ * 
+ * @param cap_size capacity size, not larger than BSTM_POW2_MAX_SIZE with
+ *                 BSTM_CONF_POW2, or BSTM_MAX_SIZE otherwise.
+ * @param flags configuration flags.
+*/
+static bstm_size_t bstm_buff_size(bstm_size_t cap_size, bstm_u32_t flags) {
+    bstm_size_t buff_size;
+
+    if (flags & BSTM_CONF_POW2) {
+        buff_size = 2;
+        while (buff_size < cap_size) {
+            buff_size <<= 1;
+        }
+
+        return buff_size;
+    }
+
+    return cap_size + 1;
+}
+
+/**
+ * @brief get a monotonic time in milliseconds, wrapping around.
+*/
+static bstm_u32_t bstm_now_ms(void) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (bstm_u32_t)ts.tv_sec * 1000u + (bstm_u32_t)(ts.tv_nsec / 1000000);
+#else
+    return (bstm_u32_t)((unsigned long long)clock() * 1000u / CLOCKS_PER_SEC);
+#endif
+}
+
+/**
+ * @brief set the size of the ring buffer, and the capacity it gives.
+ * 
+ * @param ctx context pointer.
+ * @param buff_size ring buffer size.
+*/
+static void bstm_set_size(bstm_ctx_t *ctx, bstm_size_t buff_size) {
+    ctx->buff_size = buff_size;
+    ctx->map_size = buff_size;
+    if (ctx->conf.flags & BSTM_CONF_POW2) {
+        ctx->idx_mask = buff_size - 1;
+        ctx->conf.cap_size = buff_size;
+    } else {
+        ctx->conf.cap_size = buff_size - 1;
+    }
+}
+
+#ifndef BSTM_MPSC
+
+/**
+ * @brief get a ring buffer for the first data, borrowed from the pool or
+ *        allocated lazily.
+ * 
+ * @param ctx context pointer.
+ * 
+ * @return BSTM_OK              get the buffer successfully.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+*/
+static bstm_res_t bstm_buff_get(bstm_ctx_t *ctx) {
+    bstm_seg_t *seg;
+
+    if (ctx->store == BSTM_STORE_POOL) {
+        seg = bstm_seg_get(ctx->chain.pool);
+        if (seg == NULL) {
+            return BSTM_ERR_NO_MEM;
+        }
+        ctx->ring_buff = BSTM_SEG_DATA(seg);
+    } else {
+        ctx->ring_buff = (bstm_u8_t *)malloc(ctx->buff_size);
+        if (ctx->ring_buff == NULL) {
+            return BSTM_ERR_NO_MEM;
+        }
+    }
+
+    return BSTM_OK;
+}
+
+#endif
+
+/**
+ * @brief give the ring buffer of an empty byte stream back.
+ * 
+ * @note a grown buffer comes back at the initial capacity.
+ * 
+ * @param ctx context pointer.
+*/
+static void bstm_buff_put(bstm_ctx_t *ctx) {
+    if (ctx->store == BSTM_STORE_POOL) {
+        bstm_seg_put(ctx->chain.pool, (bstm_seg_t *)ctx->ring_buff - 1);
+    } else {
+        free(ctx->ring_buff);
+        if (ctx->conf.cap_size > ctx->conf.init_size) {
+            bstm_set_size(ctx, bstm_buff_size(ctx->conf.init_size, ctx->conf.flags));
+        }
+    }
+    ctx->ring_buff = NULL;
+    ctx->head_idx = 0;
+    ctx->tail_idx = 0;
+}
+
+/**
+ * @brief reallocate the ring buffer of a growable byte stream.
+ * 
+ * @note the data is copied to the start of the new buffer in one pass, so
+ *       it doesn't wrap anymore.
+ * 
+ * @param ctx context pointer.
+ * @param cap_size new capacity size, not smaller than the used size.
+ * 
+ * @return BSTM_OK              reallocate the buffer successfully.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+*/
+static bstm_res_t bstm_resize(bstm_ctx_t *ctx, bstm_size_t cap_size) {
+    bstm_u8_t *alloc_buff;
+    bstm_size_t buff_size;
+    bstm_size_t used_size;
+
+    buff_size = bstm_buff_size(cap_size, ctx->conf.flags);
+
+    /* a lazy buffer is allocated at its new size on the first write. */
+    if (ctx->ring_buff == NULL) {
+        bstm_set_size(ctx, buff_size);
+
+        return BSTM_OK;
+    }
+
+    alloc_buff = (bstm_u8_t *)malloc(buff_size);
+    if (alloc_buff == NULL) {
+        return BSTM_ERR_NO_MEM;
+    }
+
+    /* linearize the data into the new buffer. */
+    used_size = bstm_dist(ctx, ctx->head_idx, ctx->tail_idx);
+    bstm_copy_out(ctx, alloc_buff, 0, used_size);
+    free(ctx->ring_buff);
+
+    ctx->ring_buff = alloc_buff;
+    bstm_set_size(ctx, buff_size);
+    ctx->head_idx = 0;
+    ctx->tail_idx = used_size;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief grow the ring buffer until it has enough free space.
+ * 
+ * @note the capacity is multiplied by the growth factor as many times as
+ *       needed, up to the maximum capacity.
+ * 
+ * @param ctx context pointer.
+ * @param size free space size required.
+ * 
+ * @return BSTM_OK              grow the buffer successfully.
+ *         BSTM_ERR_NO_SPACE    the byte stream isn't growable, or can't grow
+ *                              that much.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+*/
+static bstm_res_t bstm_grow(bstm_ctx_t *ctx, bstm_size_t size) {
+    bstm_size_t used_size;
+    bstm_size_t cap_size;
+
+    if ((ctx->conf.flags & BSTM_CONF_GROW) == 0) {
+        return BSTM_ERR_NO_SPACE;
+    }
+
+    used_size = bstm_dist(ctx, ctx->head_idx, ctx->tail_idx);
+    if (ctx->conf.max_size - used_size < size) {
+        return BSTM_ERR_NO_SPACE;
+    }
+
+    cap_size = ctx->conf.cap_size;
+    do {
+        if (cap_size > ctx->conf.max_size / ctx->conf.grow_factor) {
+            cap_size = ctx->conf.max_size;
+        } else {
+            cap_size *= ctx->conf.grow_factor;
+        }
+    } while (cap_size - used_size < size);
+
+    return bstm_resize(ctx, cap_size);
+}
+
+/**
+ * @brief let memory go once the byte stream has become empty.
+ * 
+ * @param ctx context pointer.
+*/
+static void bstm_emptied(bstm_ctx_t *ctx) {
+    if (ctx->ring_buff == NULL) {
+        return;
+    }
+
+    /* a borrowed buffer goes back at once, a lazy one once it's been idle. */
+    if (ctx->store == BSTM_STORE_POOL ||
+        ((ctx->conf.flags & BSTM_CONF_LAZY) && ctx->conf.idle_time == 0)) {
+        bstm_buff_put(ctx);
+
+        return;
+    }
+
+    if (ctx->conf.flags & BSTM_CONF_LAZY) {
+        ctx->idle_since = bstm_now_ms();
+    }
+
+    /* give the memory of a burst back, a failure only keeps the larger
+       buffer. */
+    if ((ctx->conf.flags & BSTM_CONF_SHRINK) &&
+        ctx->conf.cap_size > ctx->conf.init_size) {
+        bstm_resize(ctx, ctx->conf.init_size);
+    }
+}
+
+#ifdef BSTM_WAIT
+
+/**
+ * @brief get the futex word of an index, its low 32 bits.
+ * 
+ * @param idx index pointer.
+*/
+static bstm_u32_t *bstm_futex_word(bstm_size_t *idx) {
+#if defined(BSTM_SIZE_64) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return (bstm_u32_t *)idx + 1;
+#else
+    return (bstm_u32_t *)idx;
+#endif
+}
+
+/**
+ * @brief wake the side parked on an index just moved.
+ * 
+ * @note the fence orders the index store before the check of the waiters,
+ *       as a waiter sets its bit before checking the index, so one of the
+ *       two always sees the other.
+ * 
+ * @param ctx context pointer.
+ * @param idx index pointer.
+ * @param bit BSTM_WAITER_XXX.
+*/
+static void bstm_wake(bstm_ctx_t *ctx, bstm_size_t *idx, bstm_u32_t bit) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if ((__atomic_load_n(&ctx->waiters, __ATOMIC_RELAXED) & bit) == 0) {
+        return;
+    }
+
+    __atomic_fetch_and(&ctx->waiters, ~bit, __ATOMIC_RELAXED);
+    syscall(SYS_futex, bstm_futex_word(idx), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+#endif
+
+#ifdef BSTM_NOTIFY
+
+/**
+ * @brief check whether a side of the readiness notification is ready.
+ * 
+ * @note both indexes are loaded afresh, the cached ones may be stale.
+ * 
+ * @param ctx context pointer.
+ * @param dir BSTM_NOTIFY_XXX.
+*/
+static int bstm_notify_ready(bstm_ctx_t *ctx, bstm_u32_t dir) {
+    bstm_size_t used_size;
+
+    used_size = bstm_dist(ctx, BSTM_LOAD_ACQUIRE(&ctx->head_idx),
+        BSTM_LOAD_ACQUIRE(&ctx->tail_idx));
+    if (dir == BSTM_NOTIFY_READ) {
+        return used_size >= ctx->notify->side[dir].mark;
+    }
+
+    return ctx->conf.cap_size - used_size >= ctx->notify->side[dir].mark;
+}
+
+/**
+ * @brief post the eventfd of a side if it's armed and ready.
+ * 
+ * @param ctx context pointer.
+ * @param dir BSTM_NOTIFY_XXX.
+*/
+static void bstm_notify_post(bstm_ctx_t *ctx, bstm_u32_t dir) {
+    bstm_notify_side_t *side;
+    bstm_u64_t cnt;
+    ssize_t ret;
+
+    side = &ctx->notify->side[dir];
+    if (__atomic_load_n(&side->armed, __ATOMIC_ACQUIRE) == 0 ||
+        !bstm_notify_ready(ctx, dir)) {
+        return;
+    }
+
+    /* only one of the racing sides posts it. */
+    if (__atomic_exchange_n(&side->armed, 0, __ATOMIC_ACQ_REL) != 0) {
+        cnt = 1;
+        ret = write(side->fd, &cnt, sizeof(cnt));
+        (void)ret;
+    }
+}
+
+/**
+ * @brief rearm the eventfd of a side once it's no longer ready.
+ * 
+ * @note the eventfd is drained first, so it stays readable from the
+ *       crossing until the side drops back below its mark. the other side
+ *       may have made it ready again meanwhile, so it's checked again once
+ *       armed.
+ * 
+ * @param ctx context pointer.
+ * @param dir BSTM_NOTIFY_XXX.
+*/
+static void bstm_notify_rearm(bstm_ctx_t *ctx, bstm_u32_t dir) {
+    bstm_notify_side_t *side;
+    bstm_u64_t cnt;
+    ssize_t ret;
+
+    side = &ctx->notify->side[dir];
+    if (__atomic_load_n(&side->armed, __ATOMIC_RELAXED) != 0 ||
+        bstm_notify_ready(ctx, dir)) {
+        return;
+    }
+
+    ret = read(side->fd, &cnt, sizeof(cnt));
+    (void)ret;
+
+    __atomic_store_n(&side->armed, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    bstm_notify_post(ctx, dir);
+}
+
+/**
+ * @brief update the readiness notification after an index has moved.
+ * 
+ * @note the fence orders the index store before the check of the other
+ *       side, as a side rearming orders its flag before checking the
+ *       indexes, so one of the two always sees the other.
+ * 
+ * @param ctx context pointer.
+ * @param dir side that moved its index, BSTM_NOTIFY_XXX.
+*/
+static void bstm_notify_moved(bstm_ctx_t *ctx, bstm_u32_t dir) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    bstm_notify_post(ctx, dir ^ 1);
+    bstm_notify_rearm(ctx, dir);
+}
+
+#endif
+
+/**
+ * @brief check the watermark configuration.
+ * 
+ * @param conf configuration pointer, may be NULL.
+*/
+static bstm_res_t bstm_mark_check(bstm_conf_t *conf) {
+    if (conf == NULL ||
+        conf->mark_cb == NULL) {
+        return BSTM_OK;
+    }
+
+#ifdef BSTM_SPSC
+    /* a crossing would be seen by both sides at once. */
+    return BSTM_ERR;
+#else
+    if (conf->high_mark == 0 ||
+        conf->low_mark >= conf->high_mark) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    return BSTM_OK;
+#endif
+}
+
+#ifndef BSTM_SPSC
+
+/**
+ * @brief set the watermarks up, the byte stream being empty.
+ * 
+ * @param ctx context pointer.
+ * @param conf configuration pointer, may be NULL.
+*/
+static void bstm_mark_setup(bstm_ctx_t *ctx, bstm_conf_t *conf) {
+    ctx->mark.high_trip = (bstm_size_t)-1;
+    ctx->mark.low_trip = 0;
+    if (conf == NULL ||
+        conf->mark_cb == NULL) {
+        return;
+    }
+
+    ctx->mark.cb = conf->mark_cb;
+    ctx->mark.arg = conf->mark_arg;
+    ctx->mark.high = conf->high_mark;
+    ctx->mark.low = conf->low_mark;
+    ctx->mark.high_trip = conf->high_mark;
+}
+
+/**
+ * @brief call the watermark callback on a crossing.
+ * 
+ * @note the next crossing is armed first, so the callback may call the APIs.
+ * 
+ * @param ctx context pointer.
+ * @param mark crossed watermark.
+*/
+static void bstm_mark_cross(bstm_ctx_t *ctx, bstm_mark_t mark) {
+    if (mark == BSTM_MARK_HIGH) {
+        ctx->mark.high_trip = (bstm_size_t)-1;
+        ctx->mark.low_trip = ctx->mark.low + 1;
+    } else {
+        ctx->mark.high_trip = ctx->mark.high;
+        ctx->mark.low_trip = 0;
+    }
+
+    ctx->mark.cb(ctx, mark, ctx->mark.arg);
+}
+
+#endif
+
+/**
+ * @brief store the tail index moved forward, and let the consumer know.
+ * 
+ * @note the data must already be in place, segments included.
+ * 
+ * @param ctx context pointer.
+ * @param size written size.
+*/
+static void bstm_publish_tail(bstm_ctx_t *ctx, bstm_size_t size) {
+    BSTM_STORE_RELEASE(&ctx->tail_idx, bstm_next(ctx, ctx->tail_idx, size));
+
+#ifdef BSTM_WAIT
+    bstm_wake(ctx, &ctx->tail_idx, BSTM_WAITER_READ);
+#endif
+
+#ifdef BSTM_NOTIFY
+    if (ctx->notify != NULL) {
+        bstm_notify_moved(ctx, BSTM_NOTIFY_WRITE);
+    }
+#endif
+
+#ifndef BSTM_SPSC
+    if (bstm_dist(ctx, ctx->head_idx, ctx->tail_idx) >= ctx->mark.high_trip) {
+        bstm_mark_cross(ctx, BSTM_MARK_HIGH);
+    }
+#endif
+}
+
+/**
+ * @brief move the tail index forward, making written data visible.
+ * 
+ * @param ctx context pointer.
+ * @param size written size.
+*/
+static void bstm_advance_tail(bstm_ctx_t *ctx, bstm_size_t size) {
+    if (ctx->store == BSTM_STORE_CHAIN) {
+        bstm_chain_produce(ctx, size);
+    }
+
+    bstm_publish_tail(ctx, size);
+}
+
+/**
+ * @brief store the head index moved forward, and let the producer know.
+ * 
+ * @note the data must already be gone, segments included.
+ * 
+ * @param ctx context pointer.
+ * @param size read size.
+*/
+static void bstm_publish_head(bstm_ctx_t *ctx, bstm_size_t size) {
+    BSTM_STORE_RELEASE(&ctx->head_idx, bstm_next(ctx, ctx->head_idx, size));
+
+#ifdef BSTM_WAIT
+    bstm_wake(ctx, &ctx->head_idx, BSTM_WAITER_WRITE);
+#endif
+
+#ifdef BSTM_NOTIFY
+    if (ctx->notify != NULL) {
+        bstm_notify_moved(ctx, BSTM_NOTIFY_READ);
+    }
+#endif
+
+    /* the scanned data moves along with the head. */
+    if (ctx->scan_size > size) {
+        ctx->scan_size -= size;
+    } else {
+        ctx->scan_size = 0;
+    }
+
+    if ((ctx->store == BSTM_STORE_POOL ||
+         (ctx->conf.flags & (BSTM_CONF_LAZY | BSTM_CONF_SHRINK))) &&
+        ctx->head_idx == ctx->tail_idx) {
+        bstm_emptied(ctx);
+    }
+
+#ifndef BSTM_SPSC
+    if (bstm_dist(ctx, ctx->head_idx, ctx->tail_idx) < ctx->mark.low_trip) {
+        bstm_mark_cross(ctx, BSTM_MARK_LOW);
+    }
+#endif
+}
+
+/**
+ * @brief move the head index forward, giving read space back.
+ * 
+ * @param ctx context pointer.
+ * @param size read size.
+*/
+static void bstm_advance_head(bstm_ctx_t *ctx, bstm_size_t size) {
+    if (ctx->store == BSTM_STORE_CHAIN) {
+        bstm_chain_consume(ctx, size);
+    }
+
+    bstm_publish_head(ctx, size);
+}
+
+#ifdef __linux__
+
+/**
+ * @brief allocate a buffer whose pages are mapped twice, back to back.
+ * 
+ * @note a range of up to size bytes starting anywhere in the first mapping
+ *       is always contiguous in virtual memory.
+ * 
+ * @param size buffer size, must be a multiple of the page size.
+ * 
+ * @return the first mapping, or NULL on failure.
+*/
+static bstm_u8_t *bstm_mirror_alloc(bstm_size_t size) {
+    bstm_u8_t *base;
+    void *addr;
+    int fd;
+
+    fd = memfd_create("bytestream", MFD_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+
+        return NULL;
+    }
+
+    /* reserve the address range for both mappings. */
+    addr = mmap(NULL, (size_t)size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        close(fd);
+
+        return NULL;
+    }
+    base = (bstm_u8_t *)addr;
+
+    /* map the same pages over both halves. */
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, (size_t)size * 2);
+        close(fd);
+
+        return NULL;
+    }
+
+    /* the mappings keep the pages alive. */
+    close(fd);
+
+    return base;
+}
+
+#endif
+
+/**
+ * @brief free a ring buffer allocated apart from its context by bstm_new().
+ * 
+ * @param buff ring buffer.
+ * @param map_size size of the memory addressable contiguously from buff.
+ * @param store where the memory comes from, BSTM_STORE_XXX.
+*/
+static void bstm_buff_free(bstm_u8_t *buff, bstm_size_t map_size, bstm_u32_t store) {
+    switch (store) {
+#ifdef __linux__
+    case BSTM_STORE_MIRROR:
+        munmap(buff, (size_t)map_size);
+        break;
+#endif
+
+    case BSTM_STORE_GROW:
+        free(buff);
+        break;
+
+    default:
+        break;
+    }
+
+    (void)buff;
+    (void)map_size;
+}
+
+/**
+ * @brief initialize a context over its ring buffer.
+ * 
+ * @param ctx context pointer.
+ * @param buff ring buffer.
+ * @param buff_size ring buffer size.
+ * @param map_size size of the memory addressable contiguously from buff.
+ * @param flags configuration flags.
+ * @param store where the memory comes from, BSTM_STORE_XXX.
+*/
+static void bstm_setup(bstm_ctx_t *ctx, bstm_u8_t *buff, bstm_size_t buff_size,
+                       bstm_size_t map_size, bstm_u32_t flags, bstm_u32_t store) {
+    memset(ctx, 0, sizeof(bstm_ctx_t));
+    ctx->ring_buff = buff;
+    ctx->buff_size = buff_size;
+    ctx->map_size = map_size;
+    ctx->store = store;
+    ctx->conf.flags = flags;
+
+    /* indexes run freely in a power of two buffer, so no byte has to be
+       kept unused to tell a full ring from an empty one. */
+    if (flags & BSTM_CONF_POW2) {
+        ctx->idx_mask = buff_size - 1;
+        ctx->conf.cap_size = buff_size;
+    } else {
+        ctx->idx_mask = 0;
+        ctx->conf.cap_size = buff_size - 1;
+    }
+}
+
+/**
+ * @brief create a new segment pool.
+ * 
+ * @note segments are allocated on demand, a slab at a time, and kept for
+ *       reuse until the pool is deleted. the pool may be shared by byte
+ *       streams used from different threads, each thread gives segments
+ *       back to a lock-free free list of its own and takes them from it
+ *       first. a byte stream is still used from one thread at a time.
+ * 
+ * @param pool pool pointer.
+ * @param seg_size data size of a segment.
+ * 
+ * @return BSTM_OK              create pool successfully.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+ *         BSTM_ERR_BAD_SIZE    the segment size is 0, or 2GiB or more.
+*/
+bstm_res_t bstm_pool_new(bstm_pool_t **pool, bstm_size_t seg_size) {
+    bstm_pool_t *alloc_pool;
+
+    BSTM_ASSERT(pool != NULL);
+
+    if (seg_size == 0 ||
+        seg_size >= 0x80000000u) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    alloc_pool = (bstm_pool_t *)malloc(sizeof(bstm_pool_t));
+    if (alloc_pool == NULL) {
+        return BSTM_ERR_NO_MEM;
+    }
+    memset(alloc_pool, 0, sizeof(bstm_pool_t));
+    alloc_pool->seg_size = (bstm_u32_t)seg_size;
+
+    /* keep the data of every segment aligned like a pointer. */
+    alloc_pool->seg_stride = (bstm_u32_t)((sizeof(bstm_seg_t) + seg_size + sizeof(void *) - 1) &
+        ~(sizeof(void *) - 1));
+
+    /* as many segments as fit into a slab, rounded down to a power of two. */
+    alloc_pool->slab_shift = 0;
+    while (alloc_pool->seg_stride <= (BSTM_POOL_SLAB_SIZE >> (alloc_pool->slab_shift + 1))) {
+        alloc_pool->slab_shift++;
+    }
+
+    *pool = alloc_pool;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief delete the segment pool.
+ * 
+ * @note the byte streams drawing from the pool must be deleted first.
+ * 
+ * @param pool pool pointer.
+*/
+bstm_res_t bstm_pool_del(bstm_pool_t *pool) {
+    bstm_u32_t i;
+
+    BSTM_ASSERT(pool != NULL);
+
+    /* a slab whose allocation failed is left NULL. */
+    for (i = 0; i < pool->slab_cnt && i < BSTM_POOL_MAX_SLABS; i++) {
+        free(pool->slab[i]);
+    }
+    free(pool);
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief create a new byte stream in chain mode.
+ * 
+ * @param ctx context pointer.
+ * @param conf configuration pointer.
+*/
+static bstm_res_t bstm_chain_new(bstm_ctx_t **ctx, bstm_conf_t *conf) {
+#ifdef BSTM_SPSC
+    /* the segments are linked and unlinked by both sides. */
+    (void)ctx;
+    (void)conf;
+
+    return BSTM_ERR;
+#else
+    bstm_ctx_t *alloc_ctx;
+
+    /* the other buffer flags don't apply to a chain. */
+    if (conf->pool == NULL ||
+        (conf->flags & ~BSTM_CONF_CHAIN) != 0) {
+        return BSTM_ERR;
+    }
+
+    if (conf->cap_size > BSTM_MAX_SIZE) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    alloc_ctx = (bstm_ctx_t *)malloc(sizeof(bstm_ctx_t));
+    if (alloc_ctx == NULL) {
+        return BSTM_ERR_NO_MEM;
+    }
+    memset(alloc_ctx, 0, sizeof(bstm_ctx_t));
+
+    /* indexes only count the bytes, they run freely. */
+    alloc_ctx->idx_mask = (bstm_size_t)-1;
+    alloc_ctx->store = BSTM_STORE_CHAIN;
+    alloc_ctx->conf.cap_size = conf->cap_size != 0 ? conf->cap_size : BSTM_MAX_SIZE;
+    alloc_ctx->conf.flags = conf->flags;
+    alloc_ctx->chain.pool = conf->pool;
+    bstm_mark_setup(alloc_ctx, conf);
+
+    *ctx = alloc_ctx;
+
+    return BSTM_OK;
+#endif
+}
+
+/**
+ * @brief create a new byte stream borrowing its ring buffer from a pool.
+ * 
+ * @param ctx context pointer.
+ * @param conf configuration pointer.
+*/
+static bstm_res_t bstm_pool_ctx_new(bstm_ctx_t **ctx, bstm_conf_t *conf) {
+#ifdef BSTM_SPSC
+    /* the consumer would give the buffer back under the producer. */
+    (void)ctx;
+    (void)conf;
+
+    return BSTM_ERR;
+#else
+    bstm_ctx_t *alloc_ctx;
+    bstm_size_t buff_size;
+
+    /* the buffer is a segment, it can't be mirrored or reallocated. */
+    if ((conf->flags & ~BSTM_CONF_POW2) != 0) {
+        return BSTM_ERR;
+    }
+
+    buff_size = conf->pool->seg_size;
+    if (conf->flags & BSTM_CONF_POW2) {
+        if (buff_size < 2 ||
+            (buff_size & (buff_size - 1)) != 0) {
+            return BSTM_ERR_BAD_SIZE;
+        }
+    } else if (buff_size < 2) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    alloc_ctx = (bstm_ctx_t *)malloc(sizeof(bstm_ctx_t));
+    if (alloc_ctx == NULL) {
+        return BSTM_ERR_NO_MEM;
+    }
+
+    /* no buffer until there is data. */
+    bstm_setup(alloc_ctx, NULL, buff_size, buff_size, conf->flags, BSTM_STORE_POOL);
+    alloc_ctx->chain.pool = conf->pool;
+    bstm_mark_setup(alloc_ctx, conf);
+
+    *ctx = alloc_ctx;
+
+    return BSTM_OK;
+#endif
+}
+
+/**
+ * @brief create a new byte stream.
+ * 
+ * @note with BSTM_CONF_MIRROR the capacity is rounded up so that the buffer
+ *       fills whole pages. BSTM_CONF_GROW, BSTM_CONF_SHRINK and
+ *       BSTM_CONF_LAZY can't be combined with BSTM_CONF_MIRROR, nor used in
+ *       SPSC mode.
+ *       BSTM_CONF_CHAIN takes no other flag and can't be used in SPSC mode,
+ *       its capacity only bounds the data size, 0 means no limit.
+ *       without BSTM_CONF_CHAIN, a pool in conf->pool lends a segment as
+ *       the ring buffer while the byte stream holds data. the capacity then
+ *       comes from the segment size like in bstm_init(), only BSTM_CONF_POW2
+ *       may be set, and SPSC mode isn't supported.
+ *       with conf->reader_cnt readers, each one reads all the data through
+ *       the bstm_reader_xxx() APIs and the space is freed as the slowest one
+ *       moves on. only BSTM_CONF_MIRROR and BSTM_CONF_POW2 may be set, and
+ *       the other reading APIs must not be used. in SPSC mode every reader
+ *       may be on a thread of its own.
+ * 
+ * @param ctx context pointer.
+ * @param conf configuration pointer.
+ * 
+ * @return BSTM_OK              create byte stream successfully.
+ *         BSTM_ERR             the configuration isn't supported.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+ *         BSTM_ERR_BAD_SIZE    the capacity is too large, or the maximum
+ *                              capacity is smaller than it.
+*/
+bstm_res_t bstm_new(bstm_ctx_t **ctx, bstm_conf_t *conf) {
+    bstm_ctx_t *alloc_ctx;
+    bstm_u8_t *alloc_buff;
+    bstm_size_t cap_size;
+    bstm_size_t buff_size;
+    bstm_size_t map_size;
+    bstm_size_t max_size;
+    bstm_u32_t flags;
+    bstm_u32_t store;
+    bstm_res_t res;
+
+    BSTM_ASSERT(ctx != NULL);
+
+    /* get capacity size and flags. */
+    if (conf != NULL) {
+        cap_size = conf->cap_size;
+        flags = conf->flags;
+    } else {
+        cap_size = BSTM_DEF_CAP_SIZE;
+        flags = 0;
+    }
+
+#ifdef BSTM_MPSC
+    /* producers claim space on free-running indexes. */
+    flags |= BSTM_CONF_POW2;
+#endif
+
+    /* readers need a ring buffer that stays in place. */
+    if (conf != NULL &&
+        conf->reader_cnt != 0 &&
+        ((flags & ~(BSTM_CONF_MIRROR | BSTM_CONF_POW2)) != 0 ||
+         conf->pool != NULL)) {
+        return BSTM_ERR;
+    }
+
+    /* overwriting moves the head on the producer side, and a growable byte
+       stream grows instead. */
+#ifdef BSTM_SPSC
+    if (flags & BSTM_CONF_OVERWRITE) {
+        return BSTM_ERR;
+    }
+#else
+    if ((flags & BSTM_CONF_OVERWRITE) &&
+        (flags & BSTM_CONF_GROW)) {
+        return BSTM_ERR;
+    }
+#endif
+
+    res = bstm_mark_check(conf);
+    if (res != BSTM_OK) {
+        return res;
+    }
+
+    if (flags & BSTM_CONF_CHAIN) {
+        return bstm_chain_new(ctx, conf);
+    }
+
+    if (conf != NULL &&
+        conf->pool != NULL) {
+        return bstm_pool_ctx_new(ctx, conf);
+    }
+
+    /* get the ring buffer size. */
+    if (cap_size > ((flags & BSTM_CONF_POW2) ? BSTM_POW2_MAX_SIZE : BSTM_MAX_SIZE)) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+    buff_size = bstm_buff_size(cap_size, flags);
+
+    if (flags & (BSTM_CONF_GROW | BSTM_CONF_SHRINK | BSTM_CONF_LAZY)) {
+#ifdef BSTM_SPSC
+        /* the consumer can't follow the buffer being reallocated or freed. */
+        return BSTM_ERR;
+#else
+        /* a mirrored buffer can't be reallocated. */
+        if (flags & BSTM_CONF_MIRROR) {
+            return BSTM_ERR;
+        }
+
+        /* the maximum capacity is rounded up like the capacity. */
+        max_size = conf->max_size;
+        if (max_size == 0) {
+            max_size = (flags & BSTM_CONF_POW2) ? BSTM_POW2_MAX_SIZE : BSTM_MAX_SIZE;
+        } else if (max_size < cap_size ||
+                   max_size > ((flags & BSTM_CONF_POW2) ? BSTM_POW2_MAX_SIZE : BSTM_MAX_SIZE)) {
+            return BSTM_ERR_BAD_SIZE;
+        } else if (flags & BSTM_CONF_POW2) {
+            max_size = bstm_buff_size(max_size, flags);
+        }
+
+        map_size = buff_size;
+        store = BSTM_STORE_GROW;
+
+        /* allocate the ring buffer apart, so it can be reallocated, or on
+           the first write. */
+        alloc_buff = NULL;
+        if ((flags & BSTM_CONF_LAZY) == 0) {
+            alloc_buff = (bstm_u8_t *)malloc(buff_size);
+            if (alloc_buff == NULL) {
+                return BSTM_ERR_NO_MEM;
+            }
+        }
+
+        /* allocate memory for the context. */
+        alloc_ctx = (bstm_ctx_t *)malloc(sizeof(bstm_ctx_t));
+        if (alloc_ctx == NULL) {
+            bstm_buff_free(alloc_buff, map_size, store);
+
+            return BSTM_ERR_NO_MEM;
+        }
+#endif
+    } else if (flags & BSTM_CONF_MIRROR) {
+#ifdef __linux__
+        bstm_size_t page_size = (bstm_size_t)sysconf(_SC_PAGESIZE);
+
+        /* both mappings must be addressable. */
+        if (buff_size >= BSTM_POW2_MAX_SIZE - page_size) {
+            return BSTM_ERR_BAD_SIZE;
+        }
+
+        /* the buffer must fill whole pages, spare room goes to capacity. */
+        buff_size = (buff_size + page_size - 1) / page_size * page_size;
+        map_size = buff_size * 2;
+        store = BSTM_STORE_MIRROR;
+
+        /* allocate memory for the ring buffer. */
+        alloc_buff = bstm_mirror_alloc(buff_size);
+        if (alloc_buff == NULL) {
+            return BSTM_ERR_NO_MEM;
+        }
+
+        /* allocate memory for the context. */
+        alloc_ctx = (bstm_ctx_t *)malloc(sizeof(bstm_ctx_t));
+        if (alloc_ctx == NULL) {
+            bstm_buff_free(alloc_buff, map_size, store);
+
+            return BSTM_ERR_NO_MEM;
+        }
+#else
+        return BSTM_ERR;
+#endif
+    } else {
+        map_size = buff_size;
+        store = BSTM_STORE_HEAP;
+
+        /* allocate memory for the context and the ring buffer at once, the
+           buffer trailing the context from the next cache line boundary. */
+        alloc_ctx = (bstm_ctx_t *)malloc(sizeof(bstm_ctx_t) + BSTM_CACHE_LINE_SIZE - 1 + buff_size);
+        if (alloc_ctx == NULL) {
+            return BSTM_ERR_NO_MEM;
+        }
+        alloc_buff = (bstm_u8_t *)(((uintptr_t)(alloc_ctx + 1) + BSTM_CACHE_LINE_SIZE - 1) &
+            ~(uintptr_t)(BSTM_CACHE_LINE_SIZE - 1));
+    }
+
+    /* initialize the context. */
+    bstm_setup(alloc_ctx, alloc_buff, buff_size, map_size, flags, store);
+    if (store == BSTM_STORE_GROW) {
+        alloc_ctx->conf.init_size = alloc_ctx->conf.cap_size;
+        alloc_ctx->conf.max_size = max_size;
+        alloc_ctx->conf.grow_factor = conf->grow_factor >= 2 ? conf->grow_factor : BSTM_DEF_GROW_FACTOR;
+        alloc_ctx->conf.idle_time = conf->idle_time;
+    }
+
+#ifndef BSTM_SPSC
+    bstm_mark_setup(alloc_ctx, conf);
+#endif
+
+    /* all the readers start at the head. */
+    if (conf != NULL &&
+        conf->reader_cnt != 0) {
+        bstm_u32_t i;
+
+        alloc_ctx->reader = (bstm_reader_t *)calloc(conf->reader_cnt, sizeof(bstm_reader_t));
+        if (alloc_ctx->reader == NULL) {
+            bstm_del(alloc_ctx);
+
+            return BSTM_ERR_NO_MEM;
+        }
+        alloc_ctx->reader_cnt = conf->reader_cnt;
+        for (i = 0; i < conf->reader_cnt; i++) {
+            alloc_ctx->reader[i].attached = 1;
+        }
+    }
+
+    /* return the context. */
+    *ctx = alloc_ctx;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief initialize a byte stream over caller-owned memory.
+ * 
+ * @note nothing is allocated, the context lives in storage and the data in
+ *       buff, both must outlive the byte stream. storage must be at least
+ *       BSTM_CTX_SIZE bytes, suitably aligned, e.g. a bstm_ctx_storage_t.
+ *       the capacity is derived from the buffer size and conf->cap_size is
+ *       ignored: it's size with BSTM_CONF_POW2, which then requires size to
+ *       be a power of two, and size - 1 otherwise, so size is at least 2.
+ *       the buffer can't be borrowed from a pool, conf->pool must be NULL,
+ *       and there's no room for readers, conf->reader_cnt must be 0.
+ * 
+ * @param ctx context pointer.
+ * @param storage context storage.
+ * @param buff ring buffer.
+ * @param size ring buffer size.
+ * @param conf configuration pointer.
+ * 
+ * @return BSTM_OK              initialize byte stream successfully.
+ *         BSTM_ERR             the configuration isn't supported.
+ *         BSTM_ERR_BAD_SIZE    the buffer size is unsuitable.
+*/
+bstm_res_t bstm_init(bstm_ctx_t **ctx, void *storage, void *buff, bstm_size_t size, bstm_conf_t *conf) {
+    bstm_u32_t flags;
+    bstm_res_t res;
+
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(storage != NULL);
+    BSTM_ASSERT(buff != NULL);
+
+    flags = conf != NULL ? conf->flags : 0;
+
+#ifdef BSTM_MPSC
+    /* producers claim space on free-running indexes. */
+    flags |= BSTM_CONF_POW2;
+#endif
+
+    /* a caller-owned buffer can't be mirrored, reallocated or chained. */
+    if (flags & (BSTM_CONF_MIRROR | BSTM_CONF_GROW | BSTM_CONF_SHRINK |
+                 BSTM_CONF_CHAIN | BSTM_CONF_LAZY)) {
+        return BSTM_ERR;
+    }
+
+    /* the buffer is already given, there's nothing to borrow. */
+    if (conf != NULL && conf->pool != NULL) {
+        return BSTM_ERR;
+    }
+
+    /* the storage only holds the context, not the readers. */
+    if (conf != NULL && conf->reader_cnt != 0) {
+        return BSTM_ERR;
+    }
+
+#ifdef BSTM_SPSC
+    /* overwriting moves the head on the producer side. */
+    if (flags & BSTM_CONF_OVERWRITE) {
+        return BSTM_ERR;
+    }
+#endif
+
+    res = bstm_mark_check(conf);
+    if (res != BSTM_OK) {
+        return res;
+    }
+
+    /* a byte stream holds at least one byte. */
+    if (size < 2 ||
+        ((flags & BSTM_CONF_POW2) && (size & (size - 1)) != 0)) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    bstm_setup((bstm_ctx_t *)storage, (bstm_u8_t *)buff, size, size, flags, BSTM_STORE_CALLER);
+#ifndef BSTM_SPSC
+    bstm_mark_setup((bstm_ctx_t *)storage, conf);
+#endif
+    *ctx = (bstm_ctx_t *)storage;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief delete the byte stream.
+ * 
+ * @note memory given to bstm_init() is left to the caller.
+ * 
+ * @param ctx context pointer.
+*/
+bstm_res_t bstm_del(bstm_ctx_t *ctx) {
+    BSTM_ASSERT(ctx != NULL);
+
+#ifdef BSTM_NOTIFY
+    bstm_notify_close(ctx);
+#endif
+
+    if (ctx->store == BSTM_STORE_CALLER) {
+        return BSTM_OK;
+    }
+
+    if (ctx->store == BSTM_STORE_CHAIN) {
+        bstm_chain_free(ctx);
+    }
+
+    if (ctx->store == BSTM_STORE_POOL &&
+        ctx->ring_buff != NULL) {
+        bstm_buff_put(ctx);
+    }
+
+    /* free the buffer and the context. */
+    if (ctx->store != BSTM_STORE_HEAP &&
+        ctx->store != BSTM_STORE_CHAIN &&
+        ctx->store != BSTM_STORE_POOL) {
+        bstm_buff_free(ctx->ring_buff, ctx->map_size, ctx->store);
+    }
+    free(ctx->reader);
+    free(ctx);
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief get the status of the byte stream.
+ * 
+ * @note in SPSC mode the status is a snapshot, the other side may move its
+ *       index right after it was taken.
+ * 
+ * @param ctx context pointer.
+ * @param stat status pointer.
+*/
+bstm_res_t bstm_stat(bstm_ctx_t *ctx, bstm_stat_t *stat) {
+    bstm_size_t used_size;
+
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(stat != NULL);
+
+    /* get the status. */
+    used_size = bstm_dist(ctx, BSTM_LOAD_ACQUIRE(&ctx->head_idx),
+        BSTM_LOAD_ACQUIRE(&ctx->tail_idx));
+    stat->cap_size = ctx->conf.cap_size;
+    stat->free_size = ctx->conf.cap_size - used_size;
+    stat->used_size = used_size;
+    stat->drop_size = ctx->drop_size;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief get the memory of the byte stream's buffer.
+ * 
+ * @note meant for registering the buffer with an I/O engine. the region is
+ *       the whole memory addressable contiguously from the buffer, both
+ *       mappings if it's mirrored.
+ * 
+ * @param ctx context pointer.
+ * @param span region pointer.
+ * 
+ * @return BSTM_OK              get the buffer successfully.
+ *         BSTM_ERR             the buffer may be reallocated or there is no
+ *                              single buffer, it can't be registered.
+*/
+bstm_res_t bstm_get_buff(bstm_ctx_t *ctx, bstm_span_t *span) {
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(span != NULL);
+
+    if ((ctx->conf.flags & (BSTM_CONF_GROW | BSTM_CONF_SHRINK | BSTM_CONF_CHAIN | BSTM_CONF_LAZY)) ||
+        ctx->store == BSTM_STORE_POOL) {
+        return BSTM_ERR;
+    }
+
+    span->data = ctx->ring_buff;
+    span->size = ctx->map_size;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief shrink a grown or lazy byte stream.
+ * 
+ * @note meant to be called when the byte stream has been idle for a while.
+ *       the capacity goes back to the initial one, or to the smallest one
+ *       along the growth steps that still holds the data. a lazy byte
+ *       stream frees its buffer if it's been empty for idle_time.
+ * 
+ * @param ctx context pointer.
+ * 
+ * @return BSTM_OK              shrink byte stream successfully, or it's
+ *                              already as small as it can be.
+ *         BSTM_ERR             the byte stream isn't growable nor lazy.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+*/
+bstm_res_t bstm_shrink(bstm_ctx_t *ctx) {
+    bstm_size_t used_size;
+    bstm_size_t cap_size;
+
+    BSTM_ASSERT(ctx != NULL);
+
+    if (ctx->store != BSTM_STORE_GROW) {
+        return BSTM_ERR;
+    }
+
+    if (ctx->ring_buff == NULL) {
+        return BSTM_OK;
+    }
+
+    used_size = bstm_dist(ctx, ctx->head_idx, ctx->tail_idx);
+    if ((ctx->conf.flags & BSTM_CONF_LAZY) &&
+        used_size == 0 &&
+        bstm_now_ms() - ctx->idle_since >= ctx->conf.idle_time) {
+        bstm_buff_put(ctx);
+
+        return BSTM_OK;
+    }
+
+    cap_size = ctx->conf.init_size;
+    while (cap_size < used_size) {
+        if (cap_size > ctx->conf.max_size / ctx->conf.grow_factor) {
+            cap_size = ctx->conf.max_size;
+        } else {
+            cap_size *= ctx->conf.grow_factor;
+        }
+    }
+
+    if (bstm_buff_size(cap_size, ctx->conf.flags) >= ctx->buff_size) {
+        return BSTM_OK;
+    }
+
+    return bstm_resize(ctx, cap_size);
+}
+
+static bstm_eol_t bstm_find_line(bstm_ctx_t *ctx, bstm_size_t head_idx, bstm_size_t used_size,
+                                 bstm_size_t offs, bstm_size_t *scan, bstm_size_t *len);
+
+#ifndef BSTM_MPSC
+
+/**
+ * @brief drop the oldest data to make room for a write.
+ * 
+ * @note of data larger than the capacity only the end is kept. with
+ *       BSTM_CONF_SNAP_LINE whole lines are dropped, up to the first EOL
+ *       that frees enough space, so a reader never sees the end of a line
+ *       without its start.
+ * 
+ * @param ctx context pointer.
+ * @param data data pointer pointer, moved past the data not kept.
+ * @param size data size pointer, updated to the size kept.
+ * 
+ * @return BSTM_OK              make room successfully.
+ *         BSTM_ERR_NO_SPACE    no line could be dropped to make room, or the
+ *                              line is larger than the capacity.
+*/
+static bstm_res_t bstm_drop(bstm_ctx_t *ctx, const void **data, bstm_size_t *size) {
+    bstm_size_t used_size;
+    bstm_size_t drop_size;
+    bstm_size_t scan_size;
+    bstm_size_t line_size;
+
+    if (*size > ctx->conf.cap_size) {
+        if (ctx->conf.flags & BSTM_CONF_SNAP_LINE) {
+            return BSTM_ERR_NO_SPACE;
+        }
+
+        drop_size = *size - ctx->conf.cap_size;
+        *data = (const bstm_u8_t *)*data + drop_size;
+        *size = ctx->conf.cap_size;
+        ctx->drop_size += drop_size;
+    }
+
+    used_size = bstm_dist(ctx, ctx->head_idx, ctx->tail_idx);
+    if (ctx->conf.cap_size - used_size >= *size) {
+        return BSTM_OK;
+    }
+    drop_size = *size - (ctx->conf.cap_size - used_size);
+
+    /* drop up to the end of the line holding the last byte to drop. */
+    if (ctx->conf.flags & BSTM_CONF_SNAP_LINE) {
+        scan_size = 0;
+        if (bstm_find_line(ctx, ctx->head_idx, used_size, drop_size - 1,
+                           &scan_size, &line_size) == BSTM_EOL_NONE) {
+            return BSTM_ERR_NO_SPACE;
+        }
+        drop_size += line_size - 1;
+    }
+
+    ctx->drop_size += drop_size;
+    bstm_advance_head(ctx, drop_size);
+
+    return BSTM_OK;
+}
+
+#endif
+
+#ifdef BSTM_MPSC
+
+/**
+ * @brief write data as one of many producers.
+ * 
+ * @note the producer claims its range by moving the claim index forward,
+ *       copies its data in parallel with the others, then waits for the
+ *       producers that claimed before it to publish and moves the tail
+ *       index over its range. the consumer only sees whole writes.
+ * 
+ * @param ctx context pointer.
+ * @param data data pointer.
+ * @param size data size, not 0.
+*/
+static bstm_res_t bstm_mpsc_write(bstm_ctx_t *ctx, const void *data, bstm_size_t size) {
+    bstm_size_t claim_idx;
+    bstm_size_t used_size;
+    bstm_u32_t spin_cnt;
+
+    /* claim the range, the head is loaded first so it's never ahead of the
+       claim index. a head too far behind it was loaded before another
+       producer claimed space the consumer had freed since, load it again. */
+    for (;;) {
+        used_size = BSTM_LOAD_ACQUIRE(&ctx->head_idx);
+        claim_idx = __atomic_load_n(&ctx->claim_idx, __ATOMIC_RELAXED);
+        used_size = bstm_dist(ctx, used_size, claim_idx);
+        if (used_size <= ctx->conf.cap_size) {
+            if (ctx->conf.cap_size - used_size < size) {
+                return BSTM_ERR_NO_SPACE;
+            }
+            if (__atomic_compare_exchange_n(&ctx->claim_idx, &claim_idx, claim_idx + size, 0,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        BSTM_CPU_RELAX();
+    }
+
+    bstm_copy_in(ctx, claim_idx, data, size);
+
+    /* publish in claim order, a producer ahead may have been preempted. */
+    for (spin_cnt = 0; BSTM_LOAD_ACQUIRE(&ctx->tail_idx) != claim_idx; spin_cnt++) {
+        if (spin_cnt < BSTM_SPIN_LIMIT) {
+            BSTM_CPU_RELAX();
+        } else {
+#if defined(__unix__) || defined(__APPLE__)
+            sched_yield();
+#endif
+        }
+    }
+    BSTM_STORE_RELEASE(&ctx->tail_idx, claim_idx + size);
+
+#ifdef BSTM_WAIT
+    bstm_wake(ctx, &ctx->tail_idx, BSTM_WAITER_READ);
+#endif
+
+#ifdef BSTM_NOTIFY
+    if (ctx->notify != NULL) {
+        bstm_notify_moved(ctx, BSTM_NOTIFY_WRITE);
+    }
+#endif
+
+    return BSTM_OK;
+}
+
+#endif
+
+/**
+ * @brief write data to the byte stream.
+ * 
+ * @note a growable byte stream grows if the data doesn't fit, and with
+ *       BSTM_CONF_OVERWRITE the oldest data is dropped to make room. in MPSC
+ *       mode any number of producers may call it at once.
+ * 
+ * @param ctx context pointer.
+ * @param data data pointer.
+ * @param size data size.
+*/
+bstm_res_t bstm_write(bstm_ctx_t *ctx, const void *data, bstm_size_t size) {
+#ifndef BSTM_MPSC
+    bstm_res_t res;
+#endif
+
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(data != NULL);
+
+    /* if the size is 0, return immediately. */
+    if (size == 0) {
+        return BSTM_OK;
+    }
+
+#ifdef BSTM_MPSC
+    return bstm_mpsc_write(ctx, data, size);
+#else
+
+    /* check if there is enough space. */
+    if (bstm_free_size(ctx, size) < size) {
+        if (ctx->conf.flags & BSTM_CONF_OVERWRITE) {
+            res = bstm_drop(ctx, &data, &size);
+        } else {
+            res = bstm_grow(ctx, size);
+        }
+        if (res != BSTM_OK) {
+            return res;
+        }
+    }
+
+    if (ctx->store == BSTM_STORE_CHAIN) {
+
+        /* copy data to the segments. */
+        res = bstm_chain_extend(ctx, size);
+        if (res != BSTM_OK) {
+            return res;
+        }
+        bstm_chain_copy_in(ctx, data, size);
+    } else {
+
+        /* get a buffer for the first data. */
+        if (ctx->ring_buff == NULL) {
+            res = bstm_buff_get(ctx);
+            if (res != BSTM_OK) {
+                return res;
+            }
+        }
+
+        /* copy data to the ring buffer. */
+        bstm_copy_in(ctx, ctx->tail_idx, data, size);
+    }
+
+    /* publish the written data. */
+    bstm_advance_tail(ctx, size);
+
+    return BSTM_OK;
+#endif
+}
+
+#ifndef BSTM_MPSC
+
+/**
+ * @brief reserve the room of the first two segments after the tail.
+ * 
+ * @param ctx context pointer.
+ * @param span region array of 2 elements.
+ * @param free_size free space size.
+ * @param size minimum free space size required.
+*/
+static bstm_res_t bstm_chain_reserve(bstm_ctx_t *ctx, bstm_span_t *span,
+                                     bstm_size_t free_size, bstm_size_t size) {
+    bstm_size_t room_size;
+    bstm_seg_t *seg;
+    bstm_res_t res;
+    int i;
+
+    /* the room of the segment holding the tail, or of a fresh one, plus
+       one more segment is all that can be reserved. */
+    seg = ctx->chain.last;
+    room_size = ctx->chain.pool->seg_size;
+    if (seg != NULL &&
+        seg->tail != ctx->chain.pool->seg_size) {
+        room_size -= seg->tail;
+    }
+    if (size > room_size + ctx->chain.pool->seg_size) {
+        return BSTM_ERR_NO_SPACE;
+    }
+
+    res = bstm_chain_extend(ctx, size != 0 ? size : 1);
+    if (res != BSTM_OK) {
+        return res;
+    }
+
+    /* skip the segment holding the tail if it's full. */
+    seg = ctx->chain.last;
+    if (seg->tail == ctx->chain.pool->seg_size) {
+        seg = seg->next;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if (seg == NULL ||
+            free_size == 0) {
+            span[i].data = NULL;
+            span[i].size = 0;
+
+            continue;
+        }
+
+        span[i].data = BSTM_SEG_DATA(seg) + seg->tail;
+        span[i].size = ctx->chain.pool->seg_size - seg->tail;
+        if (span[i].size > free_size) {
+            span[i].size = free_size;
+        }
+        free_size -= span[i].size;
+        seg = seg->next;
+    }
+
+    if (span[0].size + span[1].size < size) {
+        return BSTM_ERR_NO_SPACE;
+    }
+
+    return BSTM_OK;
+}
+
+#endif
+
+/**
+ * @brief reserve the free space of the byte stream for writing in place.
+ * 
+ * @note the free space is returned as at most two regions, split where it
+ *       wraps around the end of the buffer. the second region is empty if
+ *       the free space doesn't wrap. nothing becomes readable until
+ *       bstm_write_commit() is called. a growable byte stream grows if it
+ *       has less than size bytes, or no free space at all. in chain mode
+ *       the regions are the room of the next two segments, appended if
+ *       needed, so they may hold less than the free space. a byte stream
+ *       borrowing its buffer from a pool, allocating it lazily or shrinking
+ *       lets it go when it's read empty, which ends the reservation. a
+ *       reservation nothing is committed to is given up with
+ *       bstm_write_cancel(). in MPSC mode producers only claim space through
+ *       bstm_write(), so writing in place isn't supported.
+ * 
+ * @param ctx context pointer.
+ * @param span region array of 2 elements.
+ * @param size minimum free space size required.
+ * 
+ * @return BSTM_OK              the free space was reserved successfully.
+ *         BSTM_ERR             MPSC mode doesn't support it.
+ *         BSTM_ERR_NO_SPACE    there are less than size bytes of free space,
+ *                              or no free space at all, or in chain mode
+ *                              more than two segments would be needed.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory to grow.
+*/
+bstm_res_t bstm_write_reserve(bstm_ctx_t *ctx, bstm_span_t *span, bstm_size_t size) {
+#ifndef BSTM_MPSC
+    bstm_size_t free_size;
+    bstm_size_t tail_offs;
+    bstm_size_t tail_to_buff_end_size;
+#endif
+
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(span != NULL);
+
+#ifdef BSTM_MPSC
+    (void)ctx;
+    (void)span;
+    (void)size;
+
+    /* the free space would be taken without a claim. */
+    return BSTM_ERR;
+#else
+
+    /* check if there is enough space. */
+    free_size = bstm_free_size(ctx, ctx->conf.cap_size);
+    if (free_size == 0 ||
+        free_size < size) {
+        bstm_res_t res = bstm_grow(ctx, size != 0 ? size : 1);
+
+        if (res != BSTM_OK) {
+            return res;
+        }
+        free_size = bstm_free_size(ctx, ctx->conf.cap_size);
+    }
+
+    if (ctx->store == BSTM_STORE_CHAIN) {
+        return bstm_chain_reserve(ctx, span, free_size, size);
+    }
+
+    /* get a buffer for the first data. */
+    if (ctx->ring_buff == NULL) {
+        bstm_res_t res = bstm_buff_get(ctx);
+
+        if (res != BSTM_OK) {
+            return res;
+        }
+    }
+
+    /* split the free space at the end of the ring buffer. */
+    tail_offs = bstm_offs(ctx, ctx->tail_idx);
+    tail_to_buff_end_size = ctx->map_size - tail_offs;
+    span[0].data = ctx->ring_buff + tail_offs;
+    if (free_size <= tail_to_buff_end_size) {
+        span[0].size = free_size;
+        span[1].data = NULL;
+        span[1].size = 0;
+    } else {
+        span[0].size = tail_to_buff_end_size;
+        span[1].data = ctx->ring_buff;
+        span[1].size = free_size - tail_to_buff_end_size;
+    }
+
+    return BSTM_OK;
+#endif
+}
+
+/**
+ * @brief commit data written in place into the reserved free space.
+ * 
+ * @note the committed bytes are the first size bytes of the regions returned
+ *       by bstm_write_reserve(), in order. like it, it isn't supported in
+ *       MPSC mode.
+ * 
+ * @param ctx context pointer.
+ * @param size written size.
+ * 
+ * @return BSTM_OK              the data was committed successfully.
+ *         BSTM_ERR             MPSC mode doesn't support it.
+ *         BSTM_ERR_NO_SPACE    size is larger than the free space, or in chain
+ *                              mode than the room reserved.
+*/
+bstm_res_t bstm_write_commit(bstm_ctx_t *ctx, bstm_size_t size) {
+    BSTM_ASSERT(ctx != NULL);
+
+#ifdef BSTM_MPSC
+    (void)ctx;
+    (void)size;
+
+    return BSTM_ERR;
+#else
+
+    /* if the size is 0, return immediately. */
+    if (size == 0) {
+        return BSTM_OK;
+    }
+
+    /* check if there is enough space, and room in the segments. */
+    if (bstm_free_size(ctx, size) < size ||
+        (ctx->store == BSTM_STORE_CHAIN &&
+         bstm_chain_room(ctx, size) < size)) {
+        return BSTM_ERR_NO_SPACE;
+    }
+
+    /* publish the written data. */
+    bstm_advance_tail(ctx, size);
+
+    return BSTM_OK;
+#endif
+}
+
+/**
+ * @brief give up a reservation nothing was committed to.
+ * 
+ * @note a byte stream left empty gives a borrowed or lazily allocated buffer
+ *       back, and shrinks, like when it's read empty.
+ * 
+ * @param ctx context pointer.
+ * 
+ * @return BSTM_OK              the reservation was given up successfully.
+*/
+bstm_res_t bstm_write_cancel(bstm_ctx_t *ctx) {
+    BSTM_ASSERT(ctx != NULL);
+
+    if ((ctx->store == BSTM_STORE_POOL ||
+         (ctx->conf.flags & (BSTM_CONF_LAZY | BSTM_CONF_SHRINK))) &&
+        ctx->head_idx == ctx->tail_idx) {
+        bstm_emptied(ctx);
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief read data from the byte stream.
+ * 
+ * @note if the data pointer is NULL, the data will be discarded without any
+ *       copying.
+ * 
+ * @param ctx context pointer.
+ * @param data data pointer.
+ * @param size data size.
+*/
+bstm_res_t bstm_read(bstm_ctx_t *ctx, void *data, bstm_size_t size) {
+    BSTM_ASSERT(ctx != NULL);
+
+    /* if the size is 0, return immediately. */
+    if (size == 0) {
+        return BSTM_OK;
+    }
+
+    /* check if there is enough data. */
+    if (bstm_used_size(ctx, size) < size) {
+        return BSTM_ERR_NO_DATA;
+    }
+
+    /* copy data from the ring buffer. */
+    if (data != NULL) {
+        bstm_copy_out(ctx, data, 0, size);
+    }
+
+    /* give the space back. */
+    bstm_advance_head(ctx, size);
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief acquire the data of the first two segments after the head.
+ * 
+ * @param ctx context pointer.
+ * @param span region array of 2 elements.
+ * @param size minimum data size required.
+*/
+static bstm_res_t bstm_chain_acquire(bstm_ctx_t *ctx, bstm_cspan_t *span, bstm_size_t size) {
+    bstm_seg_t *seg;
+    int i;
+
+    /* the segments before the tail are never empty, once trimmed. */
+    seg = ctx->chain.first;
+    for (i = 0; i < 2; i++) {
+        while (seg != NULL &&
+               seg->head == seg->tail) {
+            seg = seg->next;
+        }
+
+        if (seg == NULL) {
+            span[i].data = NULL;
+            span[i].size = 0;
+
+            continue;
+        }
+
+        span[i].data = BSTM_SEG_DATA(seg) + seg->head;
+        span[i].size = seg->tail - seg->head;
+        seg = seg->next;
+    }
+
+    if (span[0].size + span[1].size < size) {
+        return BSTM_ERR_NO_DATA;
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief acquire the data of the byte stream for reading in place.
+ * 
+ * @note the data is returned as at most two regions, from the head to the end
+ *       of the buffer, then from the start of the buffer to the tail. the
+ *       second region is empty if the data doesn't wrap. nothing is removed
+ *       until bstm_read_release() is called. in chain mode the regions are
+ *       the data of the first two segments, so they may hold less than the
+ *       data size.
+ * 
+ * @param ctx context pointer.
+ * @param span region array of 2 elements.
+ * @param size minimum data size required.
+ * 
+ * @return BSTM_OK              the data was acquired successfully.
+ *         BSTM_ERR_NO_DATA     there are less than size bytes of data, or no
+ *                              data at all, or in chain mode more than two
+ *                              segments would be needed.
+*/
+bstm_res_t bstm_read_acquire(bstm_ctx_t *ctx, bstm_cspan_t *span, bstm_size_t size) {
+    bstm_size_t used_size;
+    bstm_size_t head_offs;
+    bstm_size_t head_to_buff_end_size;
+
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(span != NULL);
+
+    /* check if there is enough data. */
+    used_size = bstm_used_size(ctx, ctx->conf.cap_size);
+    if (used_size == 0 ||
+        used_size < size) {
+        return BSTM_ERR_NO_DATA;
+    }
+
+    if (ctx->store == BSTM_STORE_CHAIN) {
+        return bstm_chain_acquire(ctx, span, size);
+    }
+
+    /* split the data at the end of the ring buffer. */
+    head_offs = bstm_offs(ctx, ctx->head_idx);
+    head_to_buff_end_size = ctx->map_size - head_offs;
+    span[0].data = ctx->ring_buff + head_offs;
+    if (used_size <= head_to_buff_end_size) {
+        span[0].size = used_size;
+        span[1].data = NULL;
+        span[1].size = 0;
+    } else {
+        span[0].size = head_to_buff_end_size;
+        span[1].data = ctx->ring_buff;
+        span[1].size = used_size - head_to_buff_end_size;
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief release data read in place from the byte stream.
+ * 
+ * @note the released bytes are the first size bytes of the regions returned
+ *       by bstm_read_acquire(), in order.
+ * 
+ * @param ctx context pointer.
+ * @param size read size.
+ * 
+ * @return BSTM_OK              the data was released successfully.
+ *         BSTM_ERR_NO_DATA     size is larger than the data size.
+*/
+bstm_res_t bstm_read_release(bstm_ctx_t *ctx, bstm_size_t size) {
+    return bstm_read(ctx, NULL, size);
+}
+
+/**
+ * @brief find the first CR or LF byte in data buffer, one byte at a time.
+ * 
+ * @param data data pointer.
+ * @param size data size.
+ * 
+ * @return offset of the byte, or size if there is none.
+*/
+static bstm_size_t find_eol_byte_scalar(const bstm_u8_t *data, bstm_size_t size) {
+    bstm_size_t offs;
+
+    for (offs = 0; offs < size; offs++) {
+        if (data[offs] == '\r' ||
+            data[offs] == '\n') {
+            break;
+        }
+    }
+
+    return offs;
+}
+
+#ifdef BSTM_SIMD_X86
+
+/**
+ * @brief find the first CR or LF byte in data buffer, 16 bytes at a time.
+ * 
+ * @param data data pointer.
+ * @param size data size.
+ * 
+ * @return offset of the byte, or size if there is none.
+*/
+__attribute__((target("sse2")))
+static bstm_size_t find_eol_byte_sse2(const bstm_u8_t *data, bstm_size_t size) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    bstm_size_t offs;
+
+    for (offs = 0; size - offs >= 16; offs += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + offs));
+        bstm_u32_t mask = (bstm_u32_t)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf)));
+
+        if (mask != 0) {
+            return offs + (bstm_size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return offs + find_eol_byte_scalar(data + offs, size - offs);
+}
+
+/**
+ * @brief find the first CR or LF byte in data buffer, 32 bytes at a time.
+ * 
+ * @param data data pointer.
+ * @param size data size.
+ * 
+ * @return offset of the byte, or size if there is none.
+*/
+__attribute__((target("avx2")))
+static bstm_size_t find_eol_byte_avx2(const bstm_u8_t *data, bstm_size_t size) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    bstm_size_t offs;
+
+    for (offs = 0; size - offs >= 32; offs += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + offs));
+        bstm_u32_t mask = (bstm_u32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, cr), _mm256_cmpeq_epi8(chunk, lf)));
+
+        if (mask != 0) {
+            return offs + (bstm_size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return offs + find_eol_byte_sse2(data + offs, size - offs);
+}
+
+static bstm_size_t find_eol_byte_detect(const bstm_u8_t *data, bstm_size_t size);
+
+/* EOL byte scanner for this CPU, picked on first use. */
+static bstm_size_t (*find_eol_byte)(const bstm_u8_t *, bstm_size_t) = find_eol_byte_detect;
+
+/**
+ * @brief pick the EOL byte scanner for this CPU, then scan with it.
+ * 
+ * @param data data pointer.
+ * @param size data size.
+ * 
+ * @return offset of the byte, or size if there is none.
+*/
+static bstm_size_t find_eol_byte_detect(const bstm_u8_t *data, bstm_size_t size) {
+    bstm_size_t (*func)(const bstm_u8_t *, bstm_size_t);
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        func = find_eol_byte_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        func = find_eol_byte_sse2;
+    } else {
+        func = find_eol_byte_scalar;
+    }
+    __atomic_store_n(&find_eol_byte, func, __ATOMIC_RELAXED);
+
+    return func(data, size);
+}
+
+#else
+
+#define find_eol_byte   find_eol_byte_scalar
+
+#endif
+
+/**
+ * @brief find EOL in data buffer.
+ * 
+ * @note CR, LF, and CRLF are both suppored.
+ * 
+ * @param data data pointer.
+ * @param size data size.
+ * @param len line length pointer.
+*/
+static bstm_eol_t find_eol(const void *data, bstm_size_t size, bstm_size_t *len) {
+    const bstm_u8_t *data_p;
+    bstm_size_t offs;
+
+    BSTM_ASSERT(data != NULL);
+    BSTM_ASSERT(size != 0);
+    BSTM_ASSERT(len != NULL);
+
+    data_p = (const bstm_u8_t *)data;
+#ifdef BSTM_SIMD_X86
+    offs = __atomic_load_n(&find_eol_byte, __ATOMIC_RELAXED)(data_p, size);
+#else
+    offs = find_eol_byte(data_p, size);
+#endif
+    if (offs == size) {
+        *len = 0;
+
+        return BSTM_EOL_NONE;
+    }
+
+    if (data_p[offs] == '\n') {
+        *len = offs + 1;
+
+        return BSTM_EOL_LF;
+    }
+
+    if (offs + 1 < size &&
+        data_p[offs + 1] == '\n') {
+        *len = offs + 2;
+
+        return BSTM_EOL_CRLF;
+    }
+    *len = offs + 1;
+
+    return BSTM_EOL_CR;
+}
+
+/* cursor walking the data of the byte stream one contiguous part at a time. */
+typedef struct _bstm_cur {
+
+    /* context pointer. */
+    bstm_ctx_t *ctx;
+
+    /* next segment, in chain mode. */
+    bstm_seg_t *seg;
+
+    /* buffer offset of the next part, in ring mode. */
+    bstm_size_t offs;
+
+    /* size of the data left. */
+    bstm_size_t left;
+} bstm_cur_t;
+
+/**
+ * @brief start walking the data from a head.
+ * 
+ * @param cur cursor pointer.
+ * @param ctx context pointer.
+ * @param head_idx head byte index, of the byte stream or of a reader.
+ * @param used_size used size seen by the caller.
+*/
+static void bstm_cur_init(bstm_cur_t *cur, bstm_ctx_t *ctx, bstm_size_t head_idx, bstm_size_t used_size) {
+    cur->ctx = ctx;
+    cur->seg = ctx->chain.first;
+    cur->offs = bstm_offs(ctx, head_idx);
+    cur->left = used_size;
+}
+
+/**
+ * @brief get the next contiguous part of the data.
+ * 
+ * @note in ring mode there are at most two parts, split where the data
+ *       wraps around the end of the buffer.
+ * 
+ * @param cur cursor pointer.
+ * @param ptr part pointer.
+ * 
+ * @return size of the part, 0 past the end of the data.
+*/
+static bstm_size_t bstm_cur_next(bstm_cur_t *cur, const bstm_u8_t **ptr) {
+    bstm_ctx_t *ctx;
+    bstm_size_t size;
+
+    if (cur->left == 0) {
+        return 0;
+    }
+
+    ctx = cur->ctx;
+    if (ctx->store == BSTM_STORE_CHAIN) {
+        while (cur->seg->head == cur->seg->tail) {
+            cur->seg = cur->seg->next;
+        }
+
+        *ptr = BSTM_SEG_DATA(cur->seg) + cur->seg->head;
+        size = cur->seg->tail - cur->seg->head;
+        cur->seg = cur->seg->next;
+    } else {
+        *ptr = ctx->ring_buff + cur->offs;
+        size = ctx->map_size - cur->offs;
+        cur->offs = 0;
+    }
+
+    if (size > cur->left) {
+        size = cur->left;
+    }
+    cur->left -= size;
+
+    return size;
+}
+
+/**
+ * @brief find a line in the byte stream.
+ * 
+ * @note scan holds how far past the head the data is known to be free of
+ *       EOL, so the next call only scans the data written since. a CR ending
+ *       the data is taken as EOL, so the scanned data never ends with a CR
+ *       waiting for its LF.
+ * 
+ * @param ctx context pointer.
+ * @param head_idx head byte index, of the byte stream or of a reader.
+ * @param used_size used size seen by the caller.
+ * @param offs offset of the line start from the head.
+ * @param scan scanned size pointer, updated on return.
+ * @param len line length pointer.
+*/
+static bstm_eol_t bstm_find_line(bstm_ctx_t *ctx, bstm_size_t head_idx, bstm_size_t used_size,
+                                 bstm_size_t offs, bstm_size_t *scan, bstm_size_t *len) {
+    const bstm_u8_t *part_ptr;
+    const bstm_u8_t *next_ptr;
+    bstm_size_t part_size;
+    bstm_size_t part_offs;
+    bstm_size_t scan_offs;
+    bstm_size_t line_end;
+    bstm_eol_t eol;
+    bstm_cur_t cur;
+
+    /* skip the data scanned already. */
+    scan_offs = *scan > offs ? *scan : offs;
+
+    bstm_cur_init(&cur, ctx, head_idx, used_size);
+    for (part_offs = 0; (part_size = bstm_cur_next(&cur, &part_ptr)) != 0; part_offs += part_size) {
+        if (scan_offs >= part_offs + part_size) {
+            continue;
+        }
+
+        eol = find_eol(part_ptr + (scan_offs - part_offs),
+            part_offs + part_size - scan_offs, &line_end);
+        if (eol == BSTM_EOL_NONE) {
+            scan_offs = part_offs + part_size;
+
+            continue;
+        }
+        line_end += scan_offs;
+
+        /* a CR ending a part may be followed by a LF starting the next one. */
+        if (eol == BSTM_EOL_CR &&
+            line_end == part_offs + part_size &&
+            bstm_cur_next(&cur, &next_ptr) != 0 &&
+            next_ptr[0] == '\n') {
+            eol = BSTM_EOL_CRLF;
+            line_end++;
+        }
+
+        /* the data before EOL is free of EOL, no need to scan it again. */
+        *scan = line_end - (eol == BSTM_EOL_CRLF ? 2 : 1);
+        *len = line_end - offs;
+
+        return eol;
+    }
+    *scan = used_size;
+
+    return BSTM_EOL_NONE;
+}
+
+/**
+ * @brief reads a line of data from the byte stream.
+ * 
+ * @note if data is NULL, then the line data won't be removed from byte stream.
+ *       if len is NULL, then line length won't be sent back to the caller.
+ *       however, data and len must not be both NULL at the same time.
+ * 
+ * @param ctx context pointer.
+ * @param data data pointer.
+ * @param size data buffer size.
+ * @param len line length pointer.
+ * 
+ * @return BSTM_OK              read line data successfully.
+ *         BSTM_ERR             generic error.
+ *         BSTM_ERR_BAD_SIZE    the data buffer size is insufficient for the incoming line data.
+ *         BSTM_ERR_NO_EOL      can't find any kind of EOL character in current byte stream.
+ * 
+*/
+bstm_res_t bstm_readline(bstm_ctx_t *ctx, void *data, bstm_size_t size, bstm_size_t *len) {
+    bstm_size_t used_size;
+    bstm_size_t line_size;
+
+    BSTM_ASSERT(ctx != NULL);
+
+    /* data and len must not be both NULL at the same time. */
+    if (data == NULL &&
+        len == NULL) {
+        return BSTM_ERR;
+    }
+
+    /* a buffer of at least 1 byte length is required. */
+    if (size == 0) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    used_size = bstm_used_size(ctx, ctx->conf.cap_size);
+    if (bstm_find_line(ctx, ctx->head_idx, used_size, 0, &ctx->scan_size, &line_size) == BSTM_EOL_NONE) {
+        return BSTM_ERR_NO_EOL;
+    }
+
+    if (line_size > size) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    if (len != NULL) {
+        *len = line_size;
+    }
+
+    /* copy and remove the line if needed. */
+    if (data != NULL) {
+        bstm_copy_out(ctx, data, 0, line_size);
+        bstm_advance_head(ctx, line_size);
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief reads many lines of data from the byte stream at once.
+ * 
+ * @note the data is scanned once and all the lines found are removed with a
+ *       single head update. the lines are copied back to back into data, and
+ *       their offsets are into data. if data is NULL, then the lines won't be
+ *       removed from byte stream, and their offsets are from its head.
+ *       it stops at max lines, at the first line that doesn't fit into the
+ *       rest of data, or when no more EOL can be found.
+ * 
+ * @param ctx context pointer.
+ * @param data data pointer.
+ * @param size data buffer size, ignored if data is NULL.
+ * @param line line descriptor array.
+ * @param max number of line descriptors.
+ * @param cnt line number pointer.
+ * 
+ * @return BSTM_OK              read lines successfully.
+ *         BSTM_ERR_BAD_SIZE    max is 0, or the data buffer size is insufficient for the first line.
+ *         BSTM_ERR_NO_EOL      can't find any kind of EOL character in current byte stream.
+*/
+bstm_res_t bstm_readlines(bstm_ctx_t *ctx, void *data, bstm_size_t size,
+                          bstm_line_t *line, bstm_size_t max, bstm_size_t *cnt) {
+    bstm_size_t used_size;
+    bstm_size_t line_size;
+    bstm_size_t scan_size;
+    bstm_size_t offs;
+    bstm_size_t num;
+    bstm_eol_t eol;
+
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(line != NULL);
+    BSTM_ASSERT(cnt != NULL);
+
+    /* at least 1 line descriptor is required. */
+    if (max == 0) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    used_size = bstm_used_size(ctx, ctx->conf.cap_size);
+    scan_size = ctx->scan_size;
+    offs = 0;
+    num = 0;
+    do {
+        eol = bstm_find_line(ctx, ctx->head_idx, used_size, offs, &scan_size, &line_size);
+        if (eol == BSTM_EOL_NONE) {
+            break;
+        }
+
+        if (data != NULL &&
+            line_size > size - offs) {
+            break;
+        }
+
+        line[num].offs = offs;
+        line[num].len = line_size;
+        line[num].eol = eol;
+        offs += line_size;
+        num++;
+    } while (num < max);
+
+    if (num == 0) {
+        if (eol == BSTM_EOL_NONE) {
+            ctx->scan_size = scan_size;
+
+            return BSTM_ERR_NO_EOL;
+        }
+
+        return BSTM_ERR_BAD_SIZE;
+    }
+    *cnt = num;
+
+    /* copy and remove all the lines at once if needed. */
+    if (data != NULL) {
+        bstm_copy_out(ctx, data, 0, offs);
+        ctx->scan_size = scan_size;
+        bstm_advance_head(ctx, offs);
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief peek data from the byte stream.
+ * 
+ * @note the data will not be removed from the byte stream.
+ * 
+ * @param ctx context pointer.
+ * @param data data buffer.
+ * @param offs offset.
+ * @param size data size.
+*/
+bstm_res_t bstm_peek(bstm_ctx_t *ctx, void *data, bstm_size_t offs, bstm_size_t size) {
+    bstm_size_t need_size;
+    bstm_size_t used_size;
+
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(data != NULL);
+
+    /* a range ending past the largest index asks for all the data. */
+    need_size = offs + (size != 0 ? size : 1);
+    if (need_size <= offs) {
+        need_size = (bstm_size_t)-1;
+    }
+
+    /* check if the offset is valid, it needs at least one byte behind it. */
+    used_size = bstm_used_size(ctx, need_size);
+    if (offs >= used_size) {
+        return BSTM_ERR_BAD_OFFS;
+    }
+
+    /* if the size is 0, return immediately. */
+    if (size == 0) {
+        return BSTM_OK;
+    }
+
+    /* check if there is enough data, offs + size may wrap. */
+    if (size > used_size - offs) {
+        return BSTM_ERR_NO_DATA;
+    }
+
+    /* copy data from the ring buffer. */
+    bstm_copy_out(ctx, data, offs, size);
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief move data from one byte stream to another.
+ * 
+ * @note when both byte streams are in chain mode on the same pool, whole
+ *       segments are unlinked from src and linked into dst without copying
+ *       their data, only partial segments are copied. the data is copied
+ *       otherwise. on BSTM_ERR_NO_MEM part of the data may have been moved.
+ * 
+ * @param dst destination context pointer.
+ * @param src source context pointer.
+ * @param size data size.
+ * 
+ * @return BSTM_OK              move data successfully.
+ *         BSTM_ERR_NO_DATA     src has less than size bytes of data.
+ *         BSTM_ERR_NO_SPACE    dst has less than size bytes of free space.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+*/
+bstm_res_t bstm_move(bstm_ctx_t *dst, bstm_ctx_t *src, bstm_size_t size) {
+    bstm_cspan_t span[2];
+    bstm_size_t part_size;
+    bstm_seg_t *seg;
+    bstm_res_t res;
+
+    BSTM_ASSERT(dst != NULL);
+    BSTM_ASSERT(src != NULL);
+    BSTM_ASSERT(dst != src);
+
+    /* if the size is 0, return immediately. */
+    if (size == 0) {
+        return BSTM_OK;
+    }
+
+    /* check if there is enough data and space. */
+    if (bstm_used_size(src, size) < size) {
+        return BSTM_ERR_NO_DATA;
+    }
+
+    if (bstm_free_size(dst, size) < size) {
+        res = bstm_grow(dst, size);
+        if (res != BSTM_OK) {
+            return res;
+        }
+    }
+
+    while (size != 0) {
+        seg = src->chain.first;
+        if (src->store == BSTM_STORE_CHAIN &&
+            dst->store == BSTM_STORE_CHAIN &&
+            src->chain.pool == dst->chain.pool &&
+            seg != src->chain.last &&
+            seg->tail - seg->head <= size) {
+            part_size = seg->tail - seg->head;
+
+            /* unlink the segment, it's neither empty nor holding the tail. */
+            src->chain.first = seg->next;
+            bstm_chain_trim(src);
+            bstm_publish_head(src, part_size);
+
+            /* link it right after the data, before the spare segments. */
+            if (dst->chain.last == NULL) {
+                seg->next = NULL;
+                dst->chain.first = seg;
+            } else {
+                seg->next = dst->chain.last->next;
+                dst->chain.last->next = seg;
+            }
+            dst->chain.last = seg;
+            bstm_chain_trim(dst);
+            bstm_publish_tail(dst, part_size);
+        } else {
+            bstm_read_acquire(src, span, 0);
+            part_size = span[0].size < size ? span[0].size : size;
+
+            res = bstm_write(dst, span[0].data, part_size);
+            if (res != BSTM_OK) {
+                return res;
+            }
+            bstm_read_release(src, part_size);
+        }
+
+        size -= part_size;
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief get an attached reader.
+ * 
+ * @param ctx context pointer.
+ * @param reader reader index.
+ * 
+ * @return reader pointer, NULL if there is no such reader attached.
+*/
+static bstm_reader_t *bstm_reader_get(bstm_ctx_t *ctx, bstm_u32_t reader) {
+    if (reader >= ctx->reader_cnt ||
+        BSTM_LOAD_ACQUIRE(&ctx->reader[reader].attached) == 0) {
+        return NULL;
+    }
+
+    return &ctx->reader[reader];
+}
+
+/**
+ * @brief get the used size seen by a reader.
+ * 
+ * @param ctx context pointer.
+ * @param rd reader pointer.
+ * @param need size the caller is interested in.
+*/
+static bstm_size_t bstm_reader_used(bstm_ctx_t *ctx, bstm_reader_t *rd, bstm_size_t need) {
+#ifdef BSTM_SPSC
+    bstm_size_t used_size;
+
+    used_size = bstm_dist(ctx, rd->head_idx, rd->tail_seen);
+    if (used_size < need) {
+        rd->tail_seen = BSTM_LOAD_ACQUIRE(&ctx->tail_idx);
+        used_size = bstm_dist(ctx, rd->head_idx, rd->tail_seen);
+    }
+
+    return used_size;
+#else
+    (void)need;
+
+    return bstm_dist(ctx, rd->head_idx, ctx->tail_idx);
+#endif
+}
+
+/**
+ * @brief move the head index of the byte stream up to the slowest reader.
+ * 
+ * @note in SPSC mode readers on different threads may move it at once, it
+ *       only ever moves forward. with no reader attached it stays, holding
+ *       the data for the next reader to attach.
+ * 
+ * @param ctx context pointer.
+*/
+static void bstm_reader_sync(bstm_ctx_t *ctx) {
+    bstm_size_t base_idx;
+    bstm_size_t slow_idx;
+    bstm_size_t slow_size;
+    bstm_size_t rd_idx;
+    bstm_size_t rd_size;
+    bstm_u32_t i;
+
+    base_idx = BSTM_LOAD_ACQUIRE(&ctx->head_idx);
+
+    /* the readers are all past the head, the slowest one is the nearest. */
+    slow_idx = base_idx;
+    slow_size = (bstm_size_t)-1;
+    for (i = 0; i < ctx->reader_cnt; i++) {
+        if (BSTM_LOAD_ACQUIRE(&ctx->reader[i].attached) == 0) {
+            continue;
+        }
+
+        rd_idx = BSTM_LOAD_ACQUIRE(&ctx->reader[i].head_idx);
+        rd_size = bstm_dist(ctx, base_idx, rd_idx);
+        if (rd_size < slow_size) {
+            slow_size = rd_size;
+            slow_idx = rd_idx;
+        }
+    }
+
+    if (slow_size == 0 ||
+        slow_size == (bstm_size_t)-1) {
+        return;
+    }
+
+#ifdef BSTM_SPSC
+    {
+        bstm_size_t head_idx = base_idx;
+
+        /* another reader may have moved it meanwhile, maybe further. */
+        while (!__atomic_compare_exchange_n(&ctx->head_idx, &head_idx, slow_idx, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+            if (bstm_dist(ctx, base_idx, head_idx) >= slow_size) {
+                return;
+            }
+        }
+
+#ifdef BSTM_WAIT
+        bstm_wake(ctx, &ctx->head_idx, BSTM_WAITER_WRITE);
+#endif
+    }
+#else
+    ctx->head_idx = slow_idx;
+
+    if (bstm_dist(ctx, ctx->head_idx, ctx->tail_idx) < ctx->mark.low_trip) {
+        bstm_mark_cross(ctx, BSTM_MARK_LOW);
+    }
+#endif
+}
+
+/**
+ * @brief move the head index of a reader forward.
+ * 
+ * @param ctx context pointer.
+ * @param rd reader pointer.
+ * @param size read size.
+*/
+static void bstm_reader_advance(bstm_ctx_t *ctx, bstm_reader_t *rd, bstm_size_t size) {
+    BSTM_STORE_RELEASE(&rd->head_idx, bstm_next(ctx, rd->head_idx, size));
+
+    /* the scanned data moves along with the head. */
+    if (rd->scan_size > size) {
+        rd->scan_size -= size;
+    } else {
+        rd->scan_size = 0;
+    }
+
+    bstm_reader_sync(ctx);
+}
+
+/**
+ * @brief attach a reader again.
+ * 
+ * @note the reader starts at the oldest data held. in SPSC mode no reader
+ *       may be reading meanwhile.
+ * 
+ * @param ctx context pointer.
+ * @param reader reader index pointer.
+ * 
+ * @return BSTM_OK              attach reader successfully.
+ *         BSTM_ERR             all the readers are attached.
+*/
+bstm_res_t bstm_reader_add(bstm_ctx_t *ctx, bstm_u32_t *reader) {
+    bstm_reader_t *rd;
+    bstm_u32_t i;
+
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(reader != NULL);
+
+    for (i = 0; i < ctx->reader_cnt; i++) {
+        rd = &ctx->reader[i];
+        if (rd->attached != 0) {
+            continue;
+        }
+
+        rd->head_idx = BSTM_LOAD_ACQUIRE(&ctx->head_idx);
+        rd->scan_size = 0;
+#ifdef BSTM_SPSC
+        rd->tail_seen = rd->head_idx;
+#endif
+        BSTM_STORE_RELEASE(&rd->attached, 1);
+        *reader = i;
+
+        return BSTM_OK;
+    }
+
+    return BSTM_ERR;
+}
+
+/**
+ * @brief detach a reader, so it no longer holds the data back.
+ * 
+ * @param ctx context pointer.
+ * @param reader reader index.
+ * 
+ * @return BSTM_OK              detach reader successfully.
+ *         BSTM_ERR             there is no such reader attached.
+*/
+bstm_res_t bstm_reader_del(bstm_ctx_t *ctx, bstm_u32_t reader) {
+    bstm_reader_t *rd;
+
+    BSTM_ASSERT(ctx != NULL);
+
+    rd = bstm_reader_get(ctx, reader);
+    if (rd == NULL) {
+        return BSTM_ERR;
+    }
+
+    BSTM_STORE_RELEASE(&rd->attached, 0);
+    bstm_reader_sync(ctx);
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief read data as a reader.
+ * 
+ * @note the data stays in the byte stream until the slowest reader has
+ *       read it. if data is NULL, the data is skipped.
+ * 
+ * @param ctx context pointer.
+ * @param reader reader index.
+ * @param data data pointer.
+ * @param size data size.
+ * 
+ * @return BSTM_OK              read data successfully.
+ *         BSTM_ERR             there is no such reader attached.
+ *         BSTM_ERR_NO_DATA     the reader has less data left than size.
+*/
+bstm_res_t bstm_reader_read(bstm_ctx_t *ctx, bstm_u32_t reader, void *data, bstm_size_t size) {
+    bstm_reader_t *rd;
+
+    BSTM_ASSERT(ctx != NULL);
+
+    rd = bstm_reader_get(ctx, reader);
+    if (rd == NULL) {
+        return BSTM_ERR;
+    }
+
+    /* if the size is 0, return immediately. */
+    if (size == 0) {
+        return BSTM_OK;
+    }
+
+    /* check if there is enough data. */
+    if (bstm_reader_used(ctx, rd, size) < size) {
+        return BSTM_ERR_NO_DATA;
+    }
+
+    if (data != NULL) {
+        bstm_copy_at(ctx, rd->head_idx, data, size);
+    }
+    bstm_reader_advance(ctx, rd, size);
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief read a line as a reader.
+ * 
+ * @note like bstm_readline(), if data is NULL the line stays in place for
+ *       the reader, data and len must not be both NULL at the same time.
+ * 
+ * @param ctx context pointer.
+ * @param reader reader index.
+ * @param data data pointer.
+ * @param size data buffer size.
+ * @param len line length pointer.
+ * 
+ * @return BSTM_OK              read line data successfully.
+ *         BSTM_ERR             there is no such reader attached, or data and
+ *                              len are both NULL.
+ *         BSTM_ERR_BAD_SIZE    the data buffer size is insufficient for the incoming line data.
+ *         BSTM_ERR_NO_EOL      can't find any kind of EOL character in the reader's data.
+*/
+bstm_res_t bstm_reader_readline(bstm_ctx_t *ctx, bstm_u32_t reader, void *data, bstm_size_t size, bstm_size_t *len) {
+    bstm_reader_t *rd;
+    bstm_size_t used_size;
+    bstm_size_t line_size;
+
+    BSTM_ASSERT(ctx != NULL);
+
+    rd = bstm_reader_get(ctx, reader);
+    if (rd == NULL ||
+        (data == NULL && len == NULL)) {
+        return BSTM_ERR;
+    }
+
+    /* a buffer of at least 1 byte length is required. */
+    if (size == 0) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    used_size = bstm_reader_used(ctx, rd, ctx->conf.cap_size);
+    if (bstm_find_line(ctx, rd->head_idx, used_size, 0, &rd->scan_size, &line_size) == BSTM_EOL_NONE) {
+        return BSTM_ERR_NO_EOL;
+    }
+
+    if (line_size > size) {
+        return BSTM_ERR_BAD_SIZE;
+    }
+
+    if (len != NULL) {
+        *len = line_size;
+    }
+
+    /* copy and skip the line if needed. */
+    if (data != NULL) {
+        bstm_copy_at(ctx, rd->head_idx, data, line_size);
+        bstm_reader_advance(ctx, rd, line_size);
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief peek data as a reader.
+ * 
+ * @param ctx context pointer.
+ * @param reader reader index.
+ * @param data data buffer.
+ * @param offs offset from the reader's head.
+ * @param size data size.
+ * 
+ * @return BSTM_OK              peek data successfully.
+ *         BSTM_ERR             there is no such reader attached.
+ *         BSTM_ERR_BAD_OFFS    the reader has no data at the offset.
+ *         BSTM_ERR_NO_DATA     the reader has less data past the offset than size.
+*/
+bstm_res_t bstm_reader_peek(bstm_ctx_t *ctx, bstm_u32_t reader, void *data, bstm_size_t offs, bstm_size_t size) {
+    bstm_reader_t *rd;
+    bstm_size_t need_size;
+    bstm_size_t used_size;
+
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(data != NULL);
+
+    rd = bstm_reader_get(ctx, reader);
+    if (rd == NULL) {
+        return BSTM_ERR;
+    }
+
+    /* a range ending past the largest index asks for all the data. */
+    need_size = offs + (size != 0 ? size : 1);
+    if (need_size <= offs) {
+        need_size = (bstm_size_t)-1;
+    }
+
+    /* check if the offset is valid, it needs at least one byte behind it. */
+    used_size = bstm_reader_used(ctx, rd, need_size);
+    if (offs >= used_size) {
+        return BSTM_ERR_BAD_OFFS;
+    }
+
+    /* if the size is 0, return immediately. */
+    if (size == 0) {
+        return BSTM_OK;
+    }
+
+    /* check if there is enough data, offs + size may wrap. */
+    if (size > used_size - offs) {
+        return BSTM_ERR_NO_DATA;
+    }
+
+    bstm_copy_at(ctx, bstm_next(ctx, rd->head_idx, offs), data, size);
+
+    return BSTM_OK;
+}
 
-#include "bytestream.h"
+#ifdef BSTM_WAIT
 
-/* context of the byte stream. */
-typedef struct _bstm_ctx {
+/* what a waiter waits for. */
+enum _bstm_wait {
 
-    /* ring buffer. */
-    bstm_u8_t *ring_buff;
+    /* data of a given size. */
+    BSTM_WAIT_DATA      = 0,
 
-    /* head byte index. */
-    bstm_u32_t head_idx;
+    /* a line. */
+    BSTM_WAIT_LINE      = 1,
 
-    /* tail byte index. */
-    bstm_u32_t tail_idx;
+    /* free space of a given size. */
+    BSTM_WAIT_SPACE     = 2,
+};
 
-    /* configuration. */
-    struct _bstm_ctx_conf {
+/**
+ * @brief check whether what a waiter waits for is there.
+ * 
+ * @param ctx context pointer.
+ * @param kind BSTM_WAIT_XXX.
+ * @param size data or free space size.
+*/
+static int bstm_wait_ready(bstm_ctx_t *ctx, bstm_u32_t kind, bstm_size_t size) {
+    bstm_size_t used_size;
+    bstm_size_t line_size;
 
-        /* capacity of the byte stream. */
-        bstm_u32_t cap_size;
-    } conf;
+    switch (kind) {
+    case BSTM_WAIT_DATA:
+        return bstm_used_size(ctx, size) >= size;
 
-    /* cached data for fast access. */
-    struct _bstm_ctx_cache {
+    case BSTM_WAIT_LINE:
+        used_size = bstm_used_size(ctx, ctx->conf.cap_size);
+        return bstm_find_line(ctx, ctx->head_idx, used_size, 0,
+                              &ctx->scan_size, &line_size) != BSTM_EOL_NONE;
 
-        /* unused buffer size. */
-        bstm_u32_t free_size;
+    default:
+        return bstm_free_size(ctx, size) >= size;
+    }
+}
 
-        /* used buffer size. */
-        bstm_u32_t used_size;
-    } cache;
-} bstm_ctx_t;
+/**
+ * @brief take the bit of a waiter done waiting back.
+ * 
+ * @note in MPSC mode other producers may be parked on the write bit, so it's
+ *       left for bstm_wake() to clear.
+ * 
+ * @param ctx context pointer.
+ * @param bit BSTM_WAITER_XXX.
+*/
+static void bstm_unwait(bstm_ctx_t *ctx, bstm_u32_t bit) {
+#ifdef BSTM_MPSC
+    if (bit == BSTM_WAITER_WRITE) {
+        return;
+    }
+#endif
 
-/* default capacity size. */
-#define BSTM_DEF_CAP_SIZE   1024
+    __atomic_fetch_and(&ctx->waiters, ~bit, __ATOMIC_RELAXED);
+}
 
 /**
- * @brief create a new byte stream.
+ * @brief wait until what a waiter waits for is there.
+ * 
+ * @note the waiter spins for a while first, then parks on the futex word of
+ *       the index the other side moves. the spins double whenever spinning
+ *       pays off and halve whenever the waiter has to park. a waiter only
+ *       checking never parks, and one done waiting takes its bit back so
+ *       the other side stops waking nobody.
  * 
  * @param ctx context pointer.
- * @param conf configuration pointer.
+ * @param kind BSTM_WAIT_XXX.
+ * @param size data or free space size.
+ * @param timeout timeout in milliseconds, negative to wait forever.
+ * 
+ * @return BSTM_OK              it's there.
+ *         BSTM_ERR_TIMEOUT     timed out.
 */
-bstm_res_t bstm_new(bstm_ctx_t **ctx, bstm_conf_t *conf) {
-    bstm_ctx_t *alloc_ctx;
-    bstm_u8_t *alloc_buff;
-    bstm_u32_t cap_size;
-    bstm_u32_t buff_size;
+static bstm_res_t bstm_wait(bstm_ctx_t *ctx, bstm_u32_t kind, bstm_size_t size, bstm_s32_t timeout) {
+    struct timespec ts;
+    bstm_size_t *idx;
+    bstm_u32_t *spin;
+    bstm_u32_t bit;
+    bstm_u32_t spin_max;
+    bstm_u32_t spin_cnt;
+    bstm_u32_t start;
+    bstm_u32_t elapsed;
+    bstm_u32_t val;
 
-    BSTM_ASSERT(ctx != NULL);
+    if (bstm_wait_ready(ctx, kind, size)) {
+        return BSTM_OK;
+    }
 
-    /* get capacity size. */
-    if (conf != NULL) {
-        cap_size = conf->cap_size;
+    if (kind == BSTM_WAIT_SPACE) {
+        idx = &ctx->head_idx;
+        spin = &ctx->write_spin;
+        bit = BSTM_WAITER_WRITE;
     } else {
-        cap_size = BSTM_DEF_CAP_SIZE;
+        idx = &ctx->tail_idx;
+        spin = &ctx->read_spin;
+        bit = BSTM_WAITER_READ;
     }
 
-    /* make sure the buffer size is a multiple of 8. */
-    buff_size = ((cap_size >> 3) + 1) << 3;
+    /* in MPSC mode producers share the spins, a stale one does no harm. */
+    spin_max = __atomic_load_n(spin, __ATOMIC_RELAXED);
+    if (spin_max < BSTM_WAIT_SPIN_MIN) {
+        spin_max = BSTM_WAIT_SPIN_MIN;
+    }
 
-    /* allocate memory for the ring buffer. */
-    alloc_buff = (bstm_u8_t *)malloc(buff_size);
-    if (alloc_buff == NULL) {
-        return BSTM_ERR_NO_MEM;
+    for (spin_cnt = 0; timeout != 0 && spin_cnt < spin_max; spin_cnt++) {
+        BSTM_CPU_RELAX();
+        if (bstm_wait_ready(ctx, kind, size)) {
+            if (spin_max < BSTM_WAIT_SPIN_MAX) {
+                __atomic_store_n(spin, spin_max * 2, __ATOMIC_RELAXED);
+            }
+
+            return BSTM_OK;
+        }
     }
 
-    /* allocate memory for the context. */
-    alloc_ctx = (bstm_ctx_t *)malloc(sizeof(bstm_ctx_t));
-    if (alloc_ctx == NULL) {
-        free(alloc_buff);
+    /* only checking, there's nothing to announce. */
+    if (timeout == 0) {
+        return BSTM_ERR_TIMEOUT;
+    }
 
-        return BSTM_ERR_NO_MEM;
+    if (spin_max > BSTM_WAIT_SPIN_MIN) {
+        __atomic_store_n(spin, spin_max / 2, __ATOMIC_RELAXED);
     }
 
-    /* initialize the context. */
-    memset(alloc_ctx, 0, sizeof(bstm_ctx_t));
-    alloc_ctx->ring_buff = alloc_buff;
-    alloc_ctx->conf.cap_size = cap_size;
-    alloc_ctx->cache.free_size = cap_size;
+    start = bstm_now_ms();
+    for (;;) {
 
-    /* return the context. */
-    *ctx = alloc_ctx;
+        /* announce the waiter before the last check, see bstm_wake(). */
+        __atomic_fetch_or(&ctx->waiters, bit, __ATOMIC_SEQ_CST);
+        val = (bstm_u32_t)__atomic_load_n(idx, __ATOMIC_SEQ_CST);
+        if (bstm_wait_ready(ctx, kind, size)) {
+            bstm_unwait(ctx, bit);
 
-    return BSTM_OK;
+            return BSTM_OK;
+        }
+
+        if (timeout >= 0) {
+            elapsed = bstm_now_ms() - start;
+            if (elapsed >= (bstm_u32_t)timeout) {
+                bstm_unwait(ctx, bit);
+
+                return BSTM_ERR_TIMEOUT;
+            }
+
+            ts.tv_sec = ((bstm_u32_t)timeout - elapsed) / 1000;
+            ts.tv_nsec = (long)(((bstm_u32_t)timeout - elapsed) % 1000) * 1000000;
+        }
+
+        /* returns at once if the index has moved since it was loaded. */
+        syscall(SYS_futex, bstm_futex_word(idx), FUTEX_WAIT_PRIVATE, val,
+                timeout >= 0 ? &ts : NULL, NULL, 0);
+    }
 }
 
 /**
- * @brief delete the byte stream.
+ * @brief wait for data to read.
+ * 
+ * @note only the consumer may call it, the data isn't read. readers aren't
+ *       waited for.
  * 
  * @param ctx context pointer.
+ * @param size data size.
+ * @param timeout timeout in milliseconds, 0 to only check, negative to wait
+ *                forever.
+ * 
+ * @return BSTM_OK              there is at least size of data.
+ *         BSTM_ERR_BAD_SIZE    size is larger than the capacity.
+ *         BSTM_ERR_TIMEOUT     timed out.
 */
-bstm_res_t bstm_del(bstm_ctx_t *ctx) {
+bstm_res_t bstm_read_wait(bstm_ctx_t *ctx, bstm_size_t size, bstm_s32_t timeout) {
     BSTM_ASSERT(ctx != NULL);
 
-    /* free the buffer and the context. */
-    free(ctx->ring_buff);
-    free(ctx);
+    if (size > ctx->conf.cap_size) {
+        return BSTM_ERR_BAD_SIZE;
+    }
 
-    return BSTM_OK;
+    return bstm_wait(ctx, BSTM_WAIT_DATA, size, timeout);
 }
 
 /**
- * @brief get the status of the byte stream.
+ * @brief wait for a line to read.
+ * 
+ * @note only the consumer may call it, the line isn't read.
  * 
  * @param ctx context pointer.
- * @param stat status pointer.
+ * @param timeout timeout in milliseconds, 0 to only check, negative to wait
+ *                forever.
+ * 
+ * @return BSTM_OK              there is a line.
+ *         BSTM_ERR_TIMEOUT     timed out.
 */
-bstm_res_t bstm_stat(bstm_ctx_t *ctx, bstm_stat_t *stat) {
+bstm_res_t bstm_readline_wait(bstm_ctx_t *ctx, bstm_s32_t timeout) {
     BSTM_ASSERT(ctx != NULL);
-    BSTM_ASSERT(stat != NULL);
 
-    /* get the status. */
-    stat->cap_size = ctx->conf.cap_size;
-    stat->free_size = ctx->cache.free_size;
-    stat->used_size = ctx->cache.used_size;
-
-    return BSTM_OK;
+    return bstm_wait(ctx, BSTM_WAIT_LINE, 0, timeout);
 }
 
 /**
- * @brief write data to the byte stream.
+ * @brief wait for free space to write.
+ * 
+ * @note only the producer may call it, in MPSC mode any producer, and
+ *       another producer may take the space first. a growable byte stream
+ *       is waited on at its current capacity.
  * 
  * @param ctx context pointer.
- * @param data data pointer.
- * @param size data size.
+ * @param size free space size.
+ * @param timeout timeout in milliseconds, 0 to only check, negative to wait
+ *                forever.
+ * 
+ * @return BSTM_OK              there is at least size of free space.
+ *         BSTM_ERR_BAD_SIZE    size is larger than the capacity.
+ *         BSTM_ERR_TIMEOUT     timed out.
 */
-bstm_res_t bstm_write(bstm_ctx_t *ctx, const void *data, bstm_size_t size) {
-    bstm_u8_t *first_copy_ptr;
-
+bstm_res_t bstm_write_wait(bstm_ctx_t *ctx, bstm_size_t size, bstm_s32_t timeout) {
     BSTM_ASSERT(ctx != NULL);
-    BSTM_ASSERT(data != NULL);
-
-    /* if the size is 0, return immediately. */
-    if (size == 0) {
-        return BSTM_OK;
-    }
 
-    /* check if there is enough space. */
-    if (ctx->cache.free_size < size) {
-        return BSTM_ERR_NO_SPACE;
+    if (size > ctx->conf.cap_size) {
+        return BSTM_ERR_BAD_SIZE;
     }
 
-    /* copy data to the ring buffer. */
-    first_copy_ptr = ctx->ring_buff + ctx->tail_idx;
-    if (ctx->conf.cap_size + 1 - ctx->tail_idx >= size) {
-        memcpy(first_copy_ptr, data, size);
-        ctx->tail_idx = (ctx->tail_idx + size) % (ctx->conf.cap_size + 1);
-    } else {
-        bstm_size_t first_copy_size = ctx->conf.cap_size + 1 - ctx->tail_idx;
-        bstm_size_t second_copy_size = size - first_copy_size;
-
-        memcpy(first_copy_ptr, data, first_copy_size);
-        memcpy(ctx->ring_buff, (bstm_u8_t *)data + first_copy_size, second_copy_size);
-        ctx->tail_idx = second_copy_size;
-    }
+    return bstm_wait(ctx, BSTM_WAIT_SPACE, size, timeout);
+}
 
-    /* update the cache. */
-    ctx->cache.used_size += size;
-    ctx->cache.free_size -= size;
+#endif
 
-    return BSTM_OK;
-}
+#ifdef BSTM_NOTIFY
 
 /**
- * @brief read data from the byte stream.
+ * @brief open eventfds telling an event loop when the byte stream is ready.
  * 
- * @note if the data pointer is NULL, the data will be discarded without any
- *       copying.
+ * @note the read eventfd becomes readable when the used size reaches
+ *       read_mark, the write eventfd when the free size reaches write_mark,
+ *       so the producer polls the write one for readability too. each is
+ *       posted once per crossing, however many writes or reads it takes,
+ *       and drained by the byte stream once its side drops back below the
+ *       mark, so neither has to be read. in SPSC mode a racing crossing may
+ *       leave one readable while its side isn't ready, so with an edge
+ *       triggered loop it costs a spurious wakeup, read until there's no
+ *       data or space left. byte streams with readers aren't supported.
+ * 
+ *       call it before the producer and consumer start, the eventfds are
+ *       closed by bstm_notify_close() or bstm_del().
  * 
  * @param ctx context pointer.
- * @param data data pointer.
- * @param size data size.
+ * @param read_mark used size the read eventfd is posted at, 0 for 1.
+ * @param write_mark free size the write eventfd is posted at, 0 for 1.
+ * @param read_fd read eventfd pointer.
+ * @param write_fd write eventfd pointer.
+ * 
+ * @return BSTM_OK              open successfully.
+ *         BSTM_ERR             they're already open, or the byte stream has
+ *                              readers.
+ *         BSTM_ERR_BAD_SIZE    a mark is larger than the capacity.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+ *         BSTM_ERR_IO          failed to create an eventfd, see errno.
 */
-bstm_res_t bstm_read(bstm_ctx_t *ctx, void *data, bstm_size_t size) {
-    bstm_u8_t *first_copy_ptr;
+bstm_res_t bstm_notify_open(bstm_ctx_t *ctx, bstm_size_t read_mark, bstm_size_t write_mark,
+                            int *read_fd, int *write_fd) {
+    bstm_notify_t *notify;
+    bstm_u32_t dir;
 
     BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(read_fd != NULL);
+    BSTM_ASSERT(write_fd != NULL);
 
-    /* if the size is 0, return immediately. */
-    if (size == 0) {
-        return BSTM_OK;
+    if (ctx->notify != NULL ||
+        ctx->reader_cnt != 0) {
+        return BSTM_ERR;
     }
 
-    /* check if there is enough data. */
-    if (ctx->cache.used_size < size) {
-        return BSTM_ERR_NO_DATA;
+    if (read_mark > ctx->conf.cap_size ||
+        write_mark > ctx->conf.cap_size) {
+        return BSTM_ERR_BAD_SIZE;
     }
 
-    /* copy data from the ring buffer. */
-    first_copy_ptr = (bstm_u8_t *)ctx->ring_buff + ctx->head_idx;
-    if (ctx->conf.cap_size + 1 - ctx->head_idx >= size) {
-        if (data != NULL) {
-            memcpy(data, first_copy_ptr, size);
-        }
-        ctx->head_idx = (ctx->head_idx + size) % (ctx->conf.cap_size + 1);
-    } else {
-        bstm_size_t first_copy_size = ctx->conf.cap_size + 1 - ctx->head_idx;
-        bstm_size_t second_copy_size = size - first_copy_size;
+    notify = (bstm_notify_t *)malloc(sizeof(bstm_notify_t));
+    if (notify == NULL) {
+        return BSTM_ERR_NO_MEM;
+    }
 
-        if (data != NULL) {
-            memcpy(data, first_copy_ptr, first_copy_size);
-            memcpy((bstm_u8_t *)data + first_copy_size, ctx->ring_buff, second_copy_size);
-        }
+    notify->side[BSTM_NOTIFY_READ].mark = read_mark != 0 ? read_mark : 1;
+    notify->side[BSTM_NOTIFY_WRITE].mark = write_mark != 0 ? write_mark : 1;
+    for (dir = 0; dir < 2; dir++) {
+        notify->side[dir].armed = 1;
+        notify->side[dir].fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (notify->side[dir].fd < 0) {
+            if (dir != 0) {
+                close(notify->side[0].fd);
+            }
+            free(notify);
 
-        ctx->head_idx = second_copy_size;
+            return BSTM_ERR_IO;
+        }
     }
 
-    /* update the cache. */
-    ctx->cache.used_size -= size;
-    ctx->cache.free_size += size;
+    /* a side may be ready already. */
+    ctx->notify = notify;
+    bstm_notify_post(ctx, BSTM_NOTIFY_READ);
+    bstm_notify_post(ctx, BSTM_NOTIFY_WRITE);
+
+    *read_fd = notify->side[BSTM_NOTIFY_READ].fd;
+    *write_fd = notify->side[BSTM_NOTIFY_WRITE].fd;
 
     return BSTM_OK;
 }
 
-typedef enum _eol {
-    EOL_NONE    = 0,
-    EOL_CR      = 1,
-    EOL_LF      = 2,
-    EOL_CRLF    = 3,
-} eol_t;
-
 /**
- * @brief find EOL in data buffer.
- * 
- * @note CR, LF, and CRLF are both suppored.
+ * @brief close the eventfds opened by bstm_notify_open().
  * 
- * @param data data pointer.
- * @param size data size.
- * @param len line length pointer.
+ * @param ctx context pointer.
 */
-static eol_t find_eol(const void *data, bstm_size_t size, bstm_size_t *len) {
-    bstm_size_t rest_size;
-    bstm_u8_t byte;
-    bstm_u8_t *data_p;
+bstm_res_t bstm_notify_close(bstm_ctx_t *ctx) {
+    BSTM_ASSERT(ctx != NULL);
 
-    BSTM_ASSERT(data != NULL);
-    BSTM_ASSERT(size != 0);
-    BSTM_ASSERT(len != NULL);
+    if (ctx->notify == NULL) {
+        return BSTM_OK;
+    }
 
-    rest_size = size;
-    data_p = (bstm_u8_t *)data;
-    while (rest_size > 0) {
-        byte = *data_p;
-        if (byte == '\r') {
-            if (rest_size - 1 >= 1) {
-                byte = *(data_p + 1);
-                if (byte == '\n') {
-                    *len = size - rest_size + 2;
-
-                    return EOL_CRLF;
-                }
-            }
-            *len = size - rest_size + 1;
+    close(ctx->notify->side[BSTM_NOTIFY_READ].fd);
+    close(ctx->notify->side[BSTM_NOTIFY_WRITE].fd);
+    free(ctx->notify);
+    ctx->notify = NULL;
+
+    return BSTM_OK;
+}
 
-            return EOL_CR;
-        } else if (byte == '\n') {
-            *len = size - rest_size + 1;
+#endif
 
-            return EOL_LF;
-        }
+#ifdef BSTM_FD_IO
 
-        rest_size--;
-        data_p++;
+/**
+ * @brief get the result of a failed file descriptor I/O.
+*/
+static bstm_res_t bstm_fd_error(void) {
+    if (errno == EAGAIN ||
+        errno == EWOULDBLOCK) {
+        return BSTM_ERR_AGAIN;
     }
-    *len = 0;
 
-    return EOL_NONE;
+    return BSTM_ERR_IO;
 }
 
 /**
- * @brief reads a line of data from the byte stream.
+ * @brief fill the byte stream from a file descriptor.
  * 
- * @note if data is NULL, then the line data won't be removed from byte stream.
- *       if len is NULL, then line length won't be sent back to the caller.
- *       however, data and len must not be both NULL at the same time.
+ * @note a single readv() reads straight into the free space, both parts of it
+ *       if it wraps. it's retried on EINTR. if nothing is read, a borrowed or
+ *       lazily allocated buffer is given back like with bstm_write_cancel().
+ *       it writes in place, so MPSC mode doesn't support it.
  * 
  * @param ctx context pointer.
- * @param data data pointer.
- * @param size data buffer size.
- * @param len line length pointer.
- * 
- * @return BSTM_OK              read line data successfully.
- *         BSTM_ERR             generic error.
- *         BSTM_ERR_BAD_SIZE    the data buffer size is insufficient for the incoming line data.
- *         BSTM_ERR_NO_EOL      can't find any kind of EOL character in current byte stream.
+ * @param fd file descriptor.
+ * @param len read size pointer, 0 means end of file.
  * 
+ * @return BSTM_OK              read data successfully, or reached end of file.
+ *         BSTM_ERR             MPSC mode doesn't support it.
+ *         BSTM_ERR_NO_SPACE    there is no free space.
+ *         BSTM_ERR_AGAIN       the file descriptor has no data for now.
+ *         BSTM_ERR_IO          readv() failed, see errno.
 */
-bstm_res_t bstm_readline(bstm_ctx_t *ctx, void *data, bstm_size_t size, bstm_size_t *len) {
-    bstm_u8_t *buff_1st_part_ptr;
-    bstm_size_t head_to_buff_end_size;
-    bstm_size_t line_size;
+bstm_res_t bstm_fill_from_fd(bstm_ctx_t *ctx, int fd, bstm_size_t *len) {
+    bstm_span_t span[2];
+    struct iovec iov[2];
+    bstm_res_t res;
+    ssize_t ret;
 
     BSTM_ASSERT(ctx != NULL);
 
-    /* data and len must not be both NULL at the same time. */
-    if (data == NULL &&
-        len == NULL) {
-        return BSTM_ERR;
-    }
-
-    /* a buffer of at least 1 byte length is required. */
-    if (size == 0) {
-        return BSTM_ERR_BAD_SIZE;
-    }
-
-    if (ctx->cache.used_size == 0) {
-        return BSTM_ERR_NO_EOL;
+    res = bstm_write_reserve(ctx, span, 0);
+    if (res != BSTM_OK) {
+        return res;
     }
 
-    buff_1st_part_ptr = ctx->ring_buff + ctx->head_idx;
-    head_to_buff_end_size = ctx->conf.cap_size + 1 - ctx->head_idx;
-    if (ctx->cache.used_size <= head_to_buff_end_size) {
-        eol_t eol;
+    iov[0].iov_base = span[0].data;
+    iov[0].iov_len = span[0].size;
+    iov[1].iov_base = span[1].data;
+    iov[1].iov_len = span[1].size;
+    do {
+        ret = readv(fd, iov, span[1].size != 0 ? 2 : 1);
+    } while (ret < 0 && errno == EINTR);
 
-        eol = find_eol(buff_1st_part_ptr, ctx->cache.used_size, &line_size);
-        if (eol == EOL_NONE) {
-            return BSTM_ERR_NO_EOL;
-        }
-
-        if (line_size > size) {
-            return BSTM_ERR_BAD_SIZE;
-        }
+    if (ret < 0) {
+        res = bstm_fd_error();
+        bstm_write_cancel(ctx);
 
-        if (data != NULL) {
-            memcpy(data, buff_1st_part_ptr, line_size);
+        return res;
+    }
 
-            ctx->head_idx = (ctx->head_idx + line_size) % (ctx->conf.cap_size + 1);
-        }
+    /* publish the data actually read, or let the reserved buffer go. */
+    if (ret > 0) {
+        bstm_advance_tail(ctx, (bstm_size_t)ret);
     } else {
-        bstm_size_t buff_1st_part_size;
-        bstm_size_t buff_2nd_part_size;
-        eol_t eol;
-
-        buff_1st_part_size = head_to_buff_end_size;
-        buff_2nd_part_size = ctx->tail_idx;
-        eol = find_eol(ctx->ring_buff + ctx->head_idx, buff_1st_part_size, &line_size);
-        if (eol == EOL_NONE) {
-            bstm_size_t line_2nd_part_size;
-
-            eol = find_eol(ctx->ring_buff, buff_2nd_part_size, &line_2nd_part_size);
-            if (eol == EOL_NONE) {
-                return BSTM_ERR_NO_EOL;
-            }
-
-            if (data != NULL) {
-                memcpy(data, buff_1st_part_ptr, buff_1st_part_size);
-                memcpy(data + buff_1st_part_size, ctx->ring_buff, line_2nd_part_size);
-
-                ctx->head_idx = line_2nd_part_size;
-            }
-
-            line_size = buff_1st_part_size + line_2nd_part_size;
-        } else if (eol == EOL_CR &&
-                   line_size == buff_1st_part_size) {
-            if (ctx->ring_buff[0] == '\n') {
-                line_size++;
-
-                if (line_size > size) {
-                    return BSTM_ERR_BAD_SIZE;
-                }
-
-                if (data != NULL) {
-                    memcpy(data, buff_1st_part_ptr, buff_1st_part_size);
-                    *((bstm_u8_t *)data + buff_1st_part_size) = '\n';
-
-                    ctx->head_idx = 1;
-                }
-            } else {
-                if (line_size > size) {
-                    return BSTM_ERR_BAD_SIZE;
-                }
-
-                if (data != NULL) {
-                    memcpy(data, buff_1st_part_ptr, line_size);
-
-                    ctx->head_idx = (ctx->head_idx + line_size) % (ctx->conf.cap_size + 1);
-                }
-            }
-        } else {
-            if (line_size > size) {
-                return BSTM_ERR_BAD_SIZE;
-            }
-
-            if (data != NULL) {
-                memcpy(data, buff_1st_part_ptr, line_size);
-
-                ctx->head_idx = (ctx->head_idx + line_size) % (ctx->conf.cap_size + 1);
-            }
-        }
-    }
-    if (len != NULL) {
-        *len = line_size;
+        bstm_write_cancel(ctx);
     }
 
-    /* update the cache if needed. */
-    if (data != NULL) {
-        ctx->cache.used_size -= line_size;
-        ctx->cache.free_size += line_size;
+    if (len != NULL) {
+        *len = (bstm_size_t)ret;
     }
 
     return BSTM_OK;
 }
 
 /**
- * @brief peek data from the byte stream.
+ * @brief drain the byte stream to a file descriptor.
  * 
- * @note the data will not be removed from the byte stream.
+ * @note a single writev() writes straight from the data, both parts of it if
+ *       it wraps. it's retried on EINTR. only the data actually written is
+ *       removed from the byte stream.
  * 
  * @param ctx context pointer.
- * @param data data buffer.
- * @param offs offset.
- * @param size data size.
+ * @param fd file descriptor.
+ * @param len written size pointer.
+ * 
+ * @return BSTM_OK              write data successfully.
+ *         BSTM_ERR_NO_DATA     there is no data.
+ *         BSTM_ERR_AGAIN       the file descriptor has no space for now.
+ *         BSTM_ERR_IO          writev() failed, see errno.
 */
-bstm_res_t bstm_peek(bstm_ctx_t *ctx, void *data, bstm_size_t offs, bstm_size_t size) {
-    bstm_u8_t *first_copy_ptr;
-    bstm_size_t temp_head_idx;
+bstm_res_t bstm_drain_to_fd(bstm_ctx_t *ctx, int fd, bstm_size_t *len) {
+    bstm_cspan_t span[2];
+    struct iovec iov[2];
+    bstm_res_t res;
+    ssize_t ret;
 
     BSTM_ASSERT(ctx != NULL);
-    BSTM_ASSERT(data != NULL);
 
-    /* check if the offset is valid. */
-    if (offs >= ctx->cache.used_size) {
-        return BSTM_ERR_BAD_OFFS;
+    res = bstm_read_acquire(ctx, span, 0);
+    if (res != BSTM_OK) {
+        return res;
     }
 
-    /* if the size is 0, return immediately. */
-    if (size == 0) {
-        return BSTM_OK;
-    }
+    iov[0].iov_base = (void *)span[0].data;
+    iov[0].iov_len = span[0].size;
+    iov[1].iov_base = (void *)span[1].data;
+    iov[1].iov_len = span[1].size;
+    do {
+        ret = writev(fd, iov, span[1].size != 0 ? 2 : 1);
+    } while (ret < 0 && errno == EINTR);
 
-    /* check if there is enough data. */
-    if (ctx->cache.used_size < offs + size) {
-        return BSTM_ERR_NO_DATA;
+    if (ret < 0) {
+        return bstm_fd_error();
     }
 
-    /* copy data from the ring buffer. */
-    temp_head_idx = (ctx->head_idx + offs) % (ctx->conf.cap_size + 1);
-    first_copy_ptr = (bstm_u8_t *)ctx->ring_buff + temp_head_idx;
-    if (ctx->conf.cap_size + 1 - temp_head_idx >= size) {
-        memcpy(data, first_copy_ptr, size);
-    } else {
-        bstm_size_t first_copy_size = ctx->conf.cap_size + 1 - temp_head_idx;
-        bstm_size_t second_copy_size = size - first_copy_size;
+    /* remove the data actually written. */
+    if (ret > 0) {
+        bstm_advance_head(ctx, (bstm_size_t)ret);
+    }
 
-        memcpy(data, first_copy_ptr, first_copy_size);
-        memcpy((bstm_u8_t *)data + first_copy_size, ctx->ring_buff, second_copy_size);
+    if (len != NULL) {
+        *len = (bstm_size_t)ret;
     }
 
     return BSTM_OK;
 }
 
+#endif
+
 /**
  * @brief clear all the data in the byte stream.
  * 
+ * @note in SPSC mode neither side may be active while clearing. memory is
+ *       let go as when the byte stream is read empty.
+ * 
  * @param ctx context pointer.
  * 
  * @return BSTM_OK clear byte stream successfully.
 */
 bstm_res_t bstm_clear(bstm_ctx_t *ctx) {
+    bstm_u32_t i;
+
     BSTM_ASSERT(ctx != NULL);
 
+    /* give the segments back. */
+    if (ctx->store == BSTM_STORE_CHAIN) {
+        bstm_chain_free(ctx);
+    }
+
     /* update indexes. */
     ctx->head_idx = 0;
     ctx->tail_idx = 0;
+    ctx->scan_size = 0;
+
+#ifdef BSTM_SPSC
+    ctx->head_seen = 0;
+    ctx->tail_seen = 0;
+#endif
 
-    /* update cache. */
-    ctx->cache.free_size = ctx->conf.cap_size;
-    ctx->cache.used_size = 0;
+#ifdef BSTM_MPSC
+    ctx->claim_idx = 0;
+#endif
+
+    for (i = 0; i < ctx->reader_cnt; i++) {
+        ctx->reader[i].head_idx = 0;
+        ctx->reader[i].scan_size = 0;
+#ifdef BSTM_SPSC
+        ctx->reader[i].tail_seen = 0;
+#endif
+    }
+
+#ifdef BSTM_WAIT
+    bstm_wake(ctx, &ctx->head_idx, BSTM_WAITER_WRITE);
+#endif
+
+#ifdef BSTM_NOTIFY
+    if (ctx->notify != NULL) {
+        bstm_notify_moved(ctx, BSTM_NOTIFY_READ);
+        bstm_notify_moved(ctx, BSTM_NOTIFY_WRITE);
+    }
+#endif
+
+    bstm_emptied(ctx);
+
+#ifndef BSTM_SPSC
+    if (ctx->mark.low_trip != 0) {
+        bstm_mark_cross(ctx, BSTM_MARK_LOW);
+    }
+#endif
 
     return BSTM_OK;
 }
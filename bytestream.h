@@ -32,6 +32,39 @@
 
 #endif
 
+/* MPSC mode builds on SPSC mode. */
+#if defined(BSTM_MPSC) && !defined(BSTM_SPSC)
+#define BSTM_SPSC
+#endif
+
+/* blocking waits build on SPSC mode, parking on Linux futexes. */
+#ifdef BSTM_WAIT
+#ifndef __linux__
+#error "BSTM_WAIT needs Linux futexes."
+#endif
+#ifndef BSTM_SPSC
+#define BSTM_SPSC
+#endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+
+/* file descriptor I/O APIs are available. */
+#define BSTM_FD_IO
+
+#endif
+
+#ifdef __linux__
+
+/* eventfd readiness notification APIs are available. */
+#define BSTM_NOTIFY
+
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* basic data types. */
 typedef signed char     bstm_s8_t;
 typedef unsigned char   bstm_u8_t;
@@ -42,7 +75,15 @@ typedef unsigned short  bstm_u16_t;
 typedef signed int      bstm_s32_t;
 typedef unsigned int    bstm_u32_t;
 
+typedef signed long long    bstm_s64_t;
+typedef unsigned long long  bstm_u64_t;
+
+/* define BSTM_SIZE_64 for byte streams of 4GiB and beyond. */
+#ifdef BSTM_SIZE_64
+typedef bstm_u64_t      bstm_size_t;
+#else
 typedef bstm_u32_t      bstm_size_t;
+#endif
 
 enum _bstm_res {
 
@@ -69,6 +110,15 @@ enum _bstm_res {
 
     /* can't find a EOL. */
     BSTM_ERR_NO_EOL     = -7,
+
+    /* file descriptor isn't ready, try again later. */
+    BSTM_ERR_AGAIN      = -8,
+
+    /* file descriptor I/O failed, see errno. */
+    BSTM_ERR_IO         = -9,
+
+    /* timed out waiting. */
+    BSTM_ERR_TIMEOUT    = -10,
 };
 
 #ifdef BSTM_DEBUG
@@ -94,43 +144,260 @@ typedef bstm_s32_t          bstm_res_t;
 
 #endif
 
+/* type of EOL. */
+typedef enum _bstm_eol {
+
+    /* no EOL. */
+    BSTM_EOL_NONE       = 0,
+
+    /* "\r". */
+    BSTM_EOL_CR         = 1,
+
+    /* "\n". */
+    BSTM_EOL_LF         = 2,
+
+    /* "\r\n". */
+    BSTM_EOL_CRLF       = 3,
+} bstm_eol_t;
+
 /* context of the byte stream. */
 typedef struct _bstm_ctx    bstm_ctx_t;
 
+/* pool of fixed-size segments shared by byte streams. */
+typedef struct _bstm_pool   bstm_pool_t;
+
+#ifndef BSTM_CACHE_LINE_SIZE
+
+/* cache line size, used to align the ring buffer and keep producer and
+   consumer fields apart. */
+#define BSTM_CACHE_LINE_SIZE    64
+
+#endif
+
+/* size of the storage a context needs, see bstm_init(): room for its fields,
+   plus the cache lines keeping the producer and the consumer apart. */
+#if defined(BSTM_MPSC)
+#define BSTM_CTX_SIZE       (256 + 4 * BSTM_CACHE_LINE_SIZE)
+#elif defined(BSTM_SPSC)
+#define BSTM_CTX_SIZE       (256 + 3 * BSTM_CACHE_LINE_SIZE)
+#else
+#define BSTM_CTX_SIZE       256
+#endif
+
+/* storage for a context living in caller-owned memory. */
+typedef union _bstm_ctx_storage {
+
+    /* raw bytes of the context. */
+    bstm_u8_t raw[BSTM_CTX_SIZE];
+
+    /* alignment of the context. */
+    void *align_ptr;
+    unsigned long long align_u64;
+} bstm_ctx_storage_t;
+
+/* map the buffer pages twice, back to back, so that data never wraps (Linux only). */
+#define BSTM_CONF_MIRROR    (1u << 0)
+
+/* round the capacity up to a power of two, so indexes are masked instead of divided. */
+#define BSTM_CONF_POW2      (1u << 1)
+
+/* grow the buffer when a write doesn't fit, instead of failing with BSTM_ERR_NO_SPACE. */
+#define BSTM_CONF_GROW      (1u << 2)
+
+/* shrink a grown buffer back to the initial capacity whenever the byte stream becomes empty. */
+#define BSTM_CONF_SHRINK    (1u << 3)
+
+/* keep the data in a chain of segments drawn from a pool instead of a ring buffer. */
+#define BSTM_CONF_CHAIN     (1u << 4)
+
+/* allocate the buffer on the first write, free it once the byte stream has been empty for a while. */
+#define BSTM_CONF_LAZY      (1u << 5)
+
+/* drop the oldest data to make room for a write, instead of failing with BSTM_ERR_NO_SPACE. */
+#define BSTM_CONF_OVERWRITE (1u << 6)
+
+/* with BSTM_CONF_OVERWRITE, drop whole lines only. */
+#define BSTM_CONF_SNAP_LINE (1u << 7)
+
+/* watermark crossed by the used size of the byte stream. */
+typedef enum _bstm_mark {
+
+    /* the used size rose to the high watermark. */
+    BSTM_MARK_HIGH      = 0,
+
+    /* the used size fell back to the low watermark. */
+    BSTM_MARK_LOW       = 1,
+} bstm_mark_t;
+
+/* watermark callback, called by the API crossing the watermark. */
+typedef void (*bstm_mark_cb_t)(bstm_ctx_t *ctx, bstm_mark_t mark, void *arg);
+
 /* configuration of the byte stream. */
 typedef struct _bstm_conf {
 
-    /* capacity of the byte stream. */
-    bstm_u32_t cap_size;
+    /* capacity of the byte stream, the initial one with BSTM_CONF_GROW. */
+    bstm_size_t cap_size;
+
+    /* configuration flags, BSTM_CONF_XXX. */
+    bstm_u32_t flags;
+
+    /* maximum capacity with BSTM_CONF_GROW, 0 means no limit. */
+    bstm_size_t max_size;
+
+    /* capacity multiplier on each growth with BSTM_CONF_GROW, 0 means 2. */
+    bstm_u32_t grow_factor;
+
+    /* segment pool with BSTM_CONF_CHAIN. */
+    bstm_pool_t *pool;
+
+    /* milliseconds an empty byte stream keeps its buffer with BSTM_CONF_LAZY, 0 frees it at once. */
+    bstm_u32_t idle_time;
+
+    /* number of readers, each reading all the data at its own pace, 0 for a single consumer. */
+    bstm_u32_t reader_cnt;
+
+    /* used size mark_cb is called at when rising to it, not 0. */
+    bstm_size_t high_mark;
+
+    /* used size mark_cb is called at when falling back to it from high_mark, below high_mark. */
+    bstm_size_t low_mark;
+
+    /* watermark callback, NULL for none, not supported in SPSC mode. */
+    bstm_mark_cb_t mark_cb;
+
+    /* argument of the watermark callback. */
+    void *mark_arg;
 } bstm_conf_t;
 
 /* status of the byte stream. */
 typedef struct _bstm_stat {
 
     /* capacity of the byte stream. */
-    bstm_u32_t cap_size;
+    bstm_size_t cap_size;
 
     /* free space size. */
-    bstm_u32_t free_size;
+    bstm_size_t free_size;
 
     /* used space size. */
-    bstm_u32_t used_size;
+    bstm_size_t used_size;
+
+    /* size of the data dropped with BSTM_CONF_OVERWRITE so far. */
+    bstm_u64_t drop_size;
 } bstm_stat_t;
 
+/* contiguous region inside the buffer of the byte stream. */
+typedef struct _bstm_span {
+
+    /* start of the region. */
+    bstm_u8_t *data;
+
+    /* size of the region. */
+    bstm_size_t size;
+} bstm_span_t;
+
+/* read-only contiguous region inside the buffer of the byte stream. */
+typedef struct _bstm_cspan {
+
+    /* start of the region. */
+    const bstm_u8_t *data;
+
+    /* size of the region. */
+    bstm_size_t size;
+} bstm_cspan_t;
+
+/* line found by bstm_readlines(). */
+typedef struct _bstm_line {
+
+    /* offset of the line. */
+    bstm_size_t offs;
+
+    /* length of the line, EOL included. */
+    bstm_size_t len;
+
+    /* type of the EOL. */
+    bstm_eol_t eol;
+} bstm_line_t;
+
+bstm_res_t bstm_pool_new(bstm_pool_t **pool, bstm_size_t seg_size);
+
+bstm_res_t bstm_pool_del(bstm_pool_t *pool);
+
 bstm_res_t bstm_new(bstm_ctx_t **ctx, bstm_conf_t *conf);
 
+bstm_res_t bstm_init(bstm_ctx_t **ctx, void *storage, void *buff, bstm_size_t size, bstm_conf_t *conf);
+
 bstm_res_t bstm_del(bstm_ctx_t *ctx);
 
 bstm_res_t bstm_stat(bstm_ctx_t *ctx, bstm_stat_t *stat);
 
+bstm_res_t bstm_get_buff(bstm_ctx_t *ctx, bstm_span_t *span);
+
+bstm_res_t bstm_shrink(bstm_ctx_t *ctx);
+
 bstm_res_t bstm_write(bstm_ctx_t *ctx, const void *data, bstm_size_t size);
 
+bstm_res_t bstm_write_reserve(bstm_ctx_t *ctx, bstm_span_t *span, bstm_size_t size);
+
+bstm_res_t bstm_write_commit(bstm_ctx_t *ctx, bstm_size_t size);
+
+bstm_res_t bstm_write_cancel(bstm_ctx_t *ctx);
+
 bstm_res_t bstm_read(bstm_ctx_t *ctx, void *data, bstm_size_t size);
 
+bstm_res_t bstm_read_acquire(bstm_ctx_t *ctx, bstm_cspan_t *span, bstm_size_t size);
+
+bstm_res_t bstm_read_release(bstm_ctx_t *ctx, bstm_size_t size);
+
 bstm_res_t bstm_readline(bstm_ctx_t *ctx, void *data, bstm_size_t size, bstm_size_t *len);
 
+bstm_res_t bstm_readlines(bstm_ctx_t *ctx, void *data, bstm_size_t size,
+                          bstm_line_t *line, bstm_size_t max, bstm_size_t *cnt);
+
 bstm_res_t bstm_peek(bstm_ctx_t *ctx, void *data, bstm_size_t offs, bstm_size_t size);
 
+bstm_res_t bstm_move(bstm_ctx_t *dst, bstm_ctx_t *src, bstm_size_t size);
+
+bstm_res_t bstm_reader_add(bstm_ctx_t *ctx, bstm_u32_t *reader);
+
+bstm_res_t bstm_reader_del(bstm_ctx_t *ctx, bstm_u32_t reader);
+
+bstm_res_t bstm_reader_read(bstm_ctx_t *ctx, bstm_u32_t reader, void *data, bstm_size_t size);
+
+bstm_res_t bstm_reader_readline(bstm_ctx_t *ctx, bstm_u32_t reader, void *data, bstm_size_t size, bstm_size_t *len);
+
+bstm_res_t bstm_reader_peek(bstm_ctx_t *ctx, bstm_u32_t reader, void *data, bstm_size_t offs, bstm_size_t size);
+
+#ifdef BSTM_WAIT
+
+bstm_res_t bstm_read_wait(bstm_ctx_t *ctx, bstm_size_t size, bstm_s32_t timeout);
+
+bstm_res_t bstm_readline_wait(bstm_ctx_t *ctx, bstm_s32_t timeout);
+
+bstm_res_t bstm_write_wait(bstm_ctx_t *ctx, bstm_size_t size, bstm_s32_t timeout);
+
+#endif
+
+#ifdef BSTM_NOTIFY
+
+bstm_res_t bstm_notify_open(bstm_ctx_t *ctx, bstm_size_t read_mark, bstm_size_t write_mark,
+                            int *read_fd, int *write_fd);
+
+bstm_res_t bstm_notify_close(bstm_ctx_t *ctx);
+
+#endif
+
+#ifdef BSTM_FD_IO
+
+bstm_res_t bstm_fill_from_fd(bstm_ctx_t *ctx, int fd, bstm_size_t *len);
+
+bstm_res_t bstm_drain_to_fd(bstm_ctx_t *ctx, int fd, bstm_size_t *len);
+
+#endif
+
 bstm_res_t bstm_clear(bstm_ctx_t *ctx);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
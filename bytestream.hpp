@@ -0,0 +1,608 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2023 Alex Chen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __BSTM_HPP__
+#define __BSTM_HPP__
+
+#include <climits>
+#include <cstring>
+#include <streambuf>
+
+#include "bytestream.h"
+
+namespace bstm {
+
+namespace detail {
+
+/**
+ * @brief round a capacity up to a power of two, at least 2.
+ * 
+ * @param size capacity.
+ * @param pow2 power of two tried.
+*/
+constexpr bstm_size_t pow2_ceil(bstm_size_t size, bstm_size_t pow2 = 2) {
+    return pow2 >= size ? pow2 : pow2_ceil(size, pow2 * 2);
+}
+
+}
+
+/**
+ * @brief byte stream with its buffer inline, header only.
+ * 
+ * @note it works like a byte stream created with BSTM_CONF_POW2: the
+ *       capacity is rounded up to a power of two at compile time, indexes
+ *       run freely and are masked by a constant, and every call is inlined.
+ *       nothing is allocated, so it lives wherever the object does. it's
+ *       moved by copying the data, and isn't thread-safe.
+ * 
+ * @param Capacity capacity of the byte stream, rounded up.
+*/
+template <bstm_size_t Capacity>
+class ring {
+public:
+
+    static_assert(Capacity != 0, "capacity must not be 0");
+    static_assert(Capacity <= ((bstm_size_t)1 << (sizeof(bstm_size_t) * 8 - 1)),
+                  "capacity is too large");
+
+    /* capacity of the byte stream. */
+    static constexpr bstm_size_t cap_size = detail::pow2_ceil(Capacity);
+
+    ring() noexcept : head_idx(0), tail_idx(0), scan_size(0) {}
+
+    ring(const ring &) = delete;
+
+    ring &operator=(const ring &) = delete;
+
+    /**
+     * @brief take the data of another byte stream, leaving it empty.
+     * 
+     * @param other byte stream to take the data of.
+    */
+    ring(ring &&other) noexcept : head_idx(0), tail_idx(0), scan_size(0) {
+        take(other);
+    }
+
+    /**
+     * @brief take the data of another byte stream, leaving it empty.
+     * 
+     * @param other byte stream to take the data of.
+    */
+    ring &operator=(ring &&other) noexcept {
+        if (this != &other) {
+            take(other);
+        }
+
+        return *this;
+    }
+
+    /**
+     * @brief get the used space size.
+    */
+    bstm_size_t used_size() const noexcept {
+        return tail_idx - head_idx;
+    }
+
+    /**
+     * @brief get the free space size.
+    */
+    bstm_size_t free_size() const noexcept {
+        return cap_size - (tail_idx - head_idx);
+    }
+
+    /**
+     * @brief write data to the byte stream.
+     * 
+     * @param data data pointer.
+     * @param size data size.
+     * 
+     * @return BSTM_OK              write data successfully.
+     *         BSTM_ERR_NO_SPACE    there isn't enough free space.
+    */
+    bstm_res_t write(const void *data, bstm_size_t size) noexcept {
+        if (size > free_size()) {
+            return BSTM_ERR_NO_SPACE;
+        }
+
+        copy_in(tail_idx, data, size);
+        tail_idx += size;
+
+        return BSTM_OK;
+    }
+
+    /**
+     * @brief read data from the byte stream.
+     * 
+     * @note if data is NULL, the data is only removed.
+     * 
+     * @param data data buffer.
+     * @param size data size.
+     * 
+     * @return BSTM_OK              read data successfully.
+     *         BSTM_ERR_NO_DATA     there isn't enough data.
+    */
+    bstm_res_t read(void *data, bstm_size_t size) noexcept {
+        if (size > used_size()) {
+            return BSTM_ERR_NO_DATA;
+        }
+
+        if (data != NULL) {
+            copy_out(head_idx, data, size);
+        }
+        advance_head(size);
+
+        return BSTM_OK;
+    }
+
+    /**
+     * @brief peek data without removing it.
+     * 
+     * @param data data buffer.
+     * @param offs offset from the head.
+     * @param size data size.
+     * 
+     * @return BSTM_OK              peek data successfully.
+     *         BSTM_ERR_BAD_OFFS    there is no data at the offset.
+     *         BSTM_ERR_NO_DATA     there is less data past the offset than size.
+    */
+    bstm_res_t peek(void *data, bstm_size_t offs, bstm_size_t size) const noexcept {
+        if (offs >= used_size()) {
+            return BSTM_ERR_BAD_OFFS;
+        }
+
+        if (size > used_size() - offs) {
+            return BSTM_ERR_NO_DATA;
+        }
+
+        copy_out(head_idx + offs, data, size);
+
+        return BSTM_OK;
+    }
+
+    /**
+     * @brief read a line, ending with "\r", "\n" or "\r\n".
+     * 
+     * @note if data is NULL, the line isn't removed. if len is NULL, the line
+     *       length isn't sent back. data and len must not be both NULL.
+     * 
+     * @param data data buffer.
+     * @param size data buffer size.
+     * @param len line length pointer.
+     * 
+     * @return BSTM_OK              read line successfully.
+     *         BSTM_ERR             data and len are both NULL.
+     *         BSTM_ERR_BAD_SIZE    the data buffer is smaller than the line.
+     *         BSTM_ERR_NO_EOL      there is no EOL.
+    */
+    bstm_res_t readline(void *data, bstm_size_t size, bstm_size_t *len) noexcept {
+        bstm_size_t line_size;
+
+        if (data == NULL &&
+            len == NULL) {
+            return BSTM_ERR;
+        }
+
+        if (size == 0) {
+            return BSTM_ERR_BAD_SIZE;
+        }
+
+        line_size = find_line();
+        if (line_size == 0) {
+            return BSTM_ERR_NO_EOL;
+        }
+
+        if (line_size > size) {
+            return BSTM_ERR_BAD_SIZE;
+        }
+
+        if (len != NULL) {
+            *len = line_size;
+        }
+
+        if (data != NULL) {
+            copy_out(head_idx, data, line_size);
+            advance_head(line_size);
+        }
+
+        return BSTM_OK;
+    }
+
+    /**
+     * @brief drop all the data.
+    */
+    void clear() noexcept {
+        head_idx = 0;
+        tail_idx = 0;
+        scan_size = 0;
+    }
+
+private:
+
+    /* index mask. */
+    static constexpr bstm_size_t idx_mask = cap_size - 1;
+
+    /**
+     * @brief copy data into the buffer from an index on, wrapping around.
+     * 
+     * @param idx byte index.
+     * @param data data pointer.
+     * @param size data size, not larger than the capacity.
+    */
+    void copy_in(bstm_size_t idx, const void *data, bstm_size_t size) noexcept {
+        bstm_size_t offs = idx & idx_mask;
+        bstm_size_t part = cap_size - offs;
+
+        if (size <= part) {
+            std::memcpy(ring_buff + offs, data, size);
+        } else {
+            std::memcpy(ring_buff + offs, data, part);
+            std::memcpy(ring_buff, (const bstm_u8_t *)data + part, size - part);
+        }
+    }
+
+    /**
+     * @brief copy data out of the buffer from an index on, wrapping around.
+     * 
+     * @param idx byte index.
+     * @param data data buffer.
+     * @param size data size, not larger than the capacity.
+    */
+    void copy_out(bstm_size_t idx, void *data, bstm_size_t size) const noexcept {
+        bstm_size_t offs = idx & idx_mask;
+        bstm_size_t part = cap_size - offs;
+
+        if (size <= part) {
+            std::memcpy(data, ring_buff + offs, size);
+        } else {
+            std::memcpy(data, ring_buff + offs, part);
+            std::memcpy((bstm_u8_t *)data + part, ring_buff, size - part);
+        }
+    }
+
+    /**
+     * @brief move the head index forward.
+     * 
+     * @param size read size.
+    */
+    void advance_head(bstm_size_t size) noexcept {
+        head_idx += size;
+
+        /* the scanned data moves along with the head. */
+        scan_size = scan_size > size ? scan_size - size : 0;
+    }
+
+    /**
+     * @brief find the first line after the head.
+     * 
+     * @note the data scanned without finding EOL isn't scanned again.
+     * 
+     * @return line length with EOL, 0 if there is no EOL.
+    */
+    bstm_size_t find_line() noexcept {
+        bstm_size_t used = used_size();
+        bstm_size_t i;
+        bstm_u8_t ch;
+
+        for (i = scan_size; i < used; i++) {
+            ch = ring_buff[(head_idx + i) & idx_mask];
+            if (ch == '\n') {
+                scan_size = i;
+
+                return i + 1;
+            }
+
+            if (ch == '\r') {
+                scan_size = i;
+                if (i + 1 < used &&
+                    ring_buff[(head_idx + i + 1) & idx_mask] == '\n') {
+                    return i + 2;
+                }
+
+                return i + 1;
+            }
+        }
+        scan_size = used;
+
+        return 0;
+    }
+
+    /**
+     * @brief take the data of another byte stream, leaving it empty.
+     * 
+     * @param other byte stream to take the data of.
+    */
+    void take(ring &other) noexcept {
+        bstm_size_t used = other.used_size();
+        bstm_size_t offs = other.head_idx & idx_mask;
+        bstm_size_t part = cap_size - offs;
+
+        /* the data lands at the start of the buffer, it only wraps when it
+           doesn't start there. */
+        if (offs == 0 ||
+            part >= used) {
+            std::memcpy(ring_buff, other.ring_buff + offs, used);
+        } else {
+            std::memcpy(ring_buff, other.ring_buff + offs, part);
+            std::memcpy(ring_buff + part, other.ring_buff, used - part);
+        }
+        head_idx = 0;
+        tail_idx = used;
+        scan_size = other.scan_size;
+        other.clear();
+    }
+
+    /* head byte index. */
+    bstm_size_t head_idx;
+
+    /* tail byte index. */
+    bstm_size_t tail_idx;
+
+    /* size of the data after the head already scanned without finding EOL. */
+    bstm_size_t scan_size;
+
+    /* ring buffer. */
+    bstm_u8_t ring_buff[cap_size];
+};
+
+template <bstm_size_t Capacity>
+constexpr bstm_size_t ring<Capacity>::cap_size;
+
+template <bstm_size_t Capacity>
+constexpr bstm_size_t ring<Capacity>::idx_mask;
+
+/**
+ * @brief stream buffer writing to and reading from a byte stream in place.
+ * 
+ * @note the put area is the free space reserved by bstm_write_reserve() up
+ *       to where it wraps, the get area the data acquired by
+ *       bstm_read_acquire() up to where it wraps, so iostream formatting goes
+ *       straight into the ring buffer. an area is moved on past the wrap
+ *       once it's used up. written data becomes readable when the stream is
+ *       flushed or the put area is used up, read data is released when the
+ *       stream is synced or the get area is used up, and both are on
+ *       destruction. writing fails once the byte stream is full, or always
+ *       in MPSC mode, and reading reaches the end once it's empty.
+ * 
+ *       moving on one area drops the other, as reserving may move a
+ *       growable buffer and releasing may give a borrowed one back. in SPSC
+ *       mode the producer and the consumer each use a stream buffer of
+ *       their own, only writing or only reading.
+*/
+class streambuf : public std::streambuf {
+public:
+
+    /**
+     * @brief create a stream buffer over a byte stream.
+     * 
+     * @param ctx context pointer, must outlive the stream buffer.
+    */
+    explicit streambuf(bstm_ctx_t *ctx) noexcept : ctx(ctx) {}
+
+    streambuf(const streambuf &) = delete;
+
+    streambuf &operator=(const streambuf &) = delete;
+
+    ~streambuf() {
+        sync();
+    }
+
+    /**
+     * @brief get the byte stream.
+    */
+    bstm_ctx_t *context() const noexcept {
+        return ctx;
+    }
+
+protected:
+
+    /**
+     * @brief move the put area on, then put a character.
+     * 
+     * @param ch character, EOF to only commit the put area.
+    */
+    int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            put_commit();
+
+            return traits_type::not_eof(ch);
+        }
+
+        if (pptr() == epptr() &&
+            !put_next()) {
+            return traits_type::eof();
+        }
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+
+        return ch;
+    }
+
+    /**
+     * @brief move the get area on.
+    */
+    int_type underflow() override {
+        if (gptr() == egptr() &&
+            !get_next()) {
+            return traits_type::eof();
+        }
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+    /**
+     * @brief put characters with bulk copies, moving the put area on as
+     *        needed.
+     * 
+     * @param s characters.
+     * @param n number of characters.
+     * 
+     * @return number of characters put, less than n once it's full.
+    */
+    std::streamsize xsputn(const char_type *s, std::streamsize n) override {
+        std::streamsize done = 0;
+        std::streamsize part;
+
+        while (done < n) {
+            if (pptr() == epptr() &&
+                !put_next()) {
+                break;
+            }
+
+            part = epptr() - pptr();
+            if (part > n - done) {
+                part = n - done;
+            }
+            std::memcpy(pptr(), s + done, (size_t)part);
+            pbump((int)part);
+            done += part;
+        }
+
+        return done;
+    }
+
+    /**
+     * @brief get characters with bulk copies, moving the get area on as
+     *        needed.
+     * 
+     * @param s character buffer.
+     * @param n number of characters.
+     * 
+     * @return number of characters got, less than n once it's empty.
+    */
+    std::streamsize xsgetn(char_type *s, std::streamsize n) override {
+        std::streamsize done = 0;
+        std::streamsize part;
+
+        while (done < n) {
+            if (gptr() == egptr() &&
+                !get_next()) {
+                break;
+            }
+
+            part = egptr() - gptr();
+            if (part > n - done) {
+                part = n - done;
+            }
+            std::memcpy(s + done, gptr(), (size_t)part);
+            gbump((int)part);
+            done += part;
+        }
+
+        return done;
+    }
+
+    /**
+     * @brief commit the written data and release the read data.
+    */
+    int sync() override {
+        put_commit();
+        get_release();
+
+        return 0;
+    }
+
+private:
+
+    /**
+     * @brief commit the data in the put area, and drop the area.
+     * 
+     * @note an area nothing was put in is given up, so a borrowed or lazily
+     *       allocated buffer reserved for it goes back.
+    */
+    void put_commit() noexcept {
+        if (pptr() != pbase()) {
+            bstm_write_commit(ctx, (bstm_size_t)(pptr() - pbase()));
+        } else if (pbase() != NULL) {
+            bstm_write_cancel(ctx);
+        }
+        setp(NULL, NULL);
+    }
+
+    /**
+     * @brief release the data got from the get area, and drop the area.
+    */
+    void get_release() noexcept {
+        if (gptr() != eback()) {
+            bstm_read_release(ctx, (bstm_size_t)(gptr() - eback()));
+        }
+        setg(NULL, NULL, NULL);
+    }
+
+    /**
+     * @brief move the put area on to the next free region.
+     * 
+     * @return false if the byte stream is full.
+    */
+    bool put_next() noexcept {
+        bstm_span_t span[2];
+        bstm_size_t size;
+        int i;
+
+        get_release();
+        put_commit();
+        if (bstm_write_reserve(ctx, span, 0) != BSTM_OK) {
+            return false;
+        }
+
+        /* the area is bumped by int. */
+        i = span[0].size != 0 ? 0 : 1;
+        size = span[i].size < (bstm_size_t)INT_MAX ? span[i].size : (bstm_size_t)INT_MAX;
+        setp((char *)span[i].data, (char *)span[i].data + size);
+
+        return true;
+    }
+
+    /**
+     * @brief move the get area on to the next data region.
+     * 
+     * @return false if the byte stream is empty.
+    */
+    bool get_next() noexcept {
+        bstm_cspan_t span[2];
+        bstm_size_t size;
+        char *data;
+        int i;
+
+        put_commit();
+        get_release();
+        if (bstm_read_acquire(ctx, span, 0) != BSTM_OK) {
+            return false;
+        }
+
+        /* the area is bumped by int. */
+        i = span[0].size != 0 ? 0 : 1;
+        size = span[i].size < (bstm_size_t)INT_MAX ? span[i].size : (bstm_size_t)INT_MAX;
+        data = (char *)span[i].data;
+        setg(data, data, data + size);
+
+        return true;
+    }
+
+    /* byte stream. */
+    bstm_ctx_t *ctx;
+};
+
+}
+
+#endif
@@ -0,0 +1,653 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2023 Alex Chen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+
+#include "bytestream_uring.h"
+
+/* attached byte stream. */
+typedef struct _bstm_uring_slot {
+
+    /* context of the byte stream, NULL if the slot is free. */
+    bstm_ctx_t *ctx;
+
+    /* user data given by the caller. */
+    void *user;
+
+    /* I/O in flight, one bit per bstm_uring_op_t. */
+    bstm_u32_t busy;
+} bstm_uring_slot_t;
+
+/* io_uring engine. */
+typedef struct _bstm_uring {
+
+    /* io_uring file descriptor. */
+    int ring_fd;
+
+    /* submission queue ring. */
+    struct _bstm_uring_sq {
+        unsigned *head;
+        unsigned *tail;
+        unsigned *mask;
+        unsigned *array;
+        unsigned entries;
+
+        /* submission queue entries. */
+        struct io_uring_sqe *sqes;
+
+        /* entries queued but not submitted yet. */
+        unsigned pending;
+    } sq;
+
+    /* completion queue ring. */
+    struct _bstm_uring_cq {
+        unsigned *head;
+        unsigned *tail;
+        unsigned *mask;
+        struct io_uring_cqe *cqes;
+    } cq;
+
+    /* mapped memory. */
+    struct _bstm_uring_map {
+        void *sq_ptr;
+        size_t sq_size;
+        void *cq_ptr;
+        size_t cq_size;
+        size_t sqes_size;
+    } map;
+
+    /* attached byte streams, indexed by their registered buffer slot. */
+    bstm_uring_slot_t *slot;
+
+    /* free slot stack. */
+    bstm_u32_t *free_slot;
+
+    /* free slot number. */
+    bstm_u32_t free_cnt;
+
+    /* maximum number of byte streams. */
+    bstm_u32_t max_stms;
+} bstm_uring_t;
+
+/* default submission queue size. */
+#define BSTM_URING_DEF_SQ_SIZE      256
+
+/* default maximum number of byte streams. */
+#define BSTM_URING_DEF_MAX_STMS     1024
+
+/* largest submission queue, as Linux caps it. */
+#define BSTM_URING_MAX_SQ_SIZE      32768
+
+/* largest number of byte streams, as the fixed buffer index is 16 bits. */
+#define BSTM_URING_MAX_STMS         16384
+
+/* largest transfer of a single read or write, as Linux caps it. */
+#define BSTM_URING_MAX_IO           0x7FFFF000u
+
+/* io_uring_setup() system call. */
+static int bstm_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+/* io_uring_enter() system call. */
+static int bstm_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/* io_uring_register() system call. */
+static int bstm_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * @brief register a buffer into a slot of the sparse fixed buffer table.
+ * 
+ * @param ring engine pointer.
+ * @param slot slot index.
+ * @param data buffer, NULL to clear the slot.
+ * @param size buffer size.
+*/
+static bstm_res_t bstm_uring_set_buff(bstm_uring_t *ring, bstm_u32_t slot, void *data, bstm_size_t size) {
+    struct io_uring_rsrc_update2 update;
+    struct iovec iov;
+    __u64 tag;
+
+    iov.iov_base = data;
+    iov.iov_len = size;
+    tag = 0;
+
+    memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.data = (__u64)(uintptr_t)&iov;
+    update.tags = (__u64)(uintptr_t)&tag;
+    update.nr = 1;
+    if (bstm_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) < 0) {
+        return BSTM_ERR_IO;
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief unmap the rings and close the io_uring.
+ * 
+ * @param ring engine pointer.
+*/
+static void bstm_uring_close(bstm_uring_t *ring) {
+    if (ring->sq.sqes != NULL) {
+        munmap(ring->sq.sqes, ring->map.sqes_size);
+    }
+    if (ring->map.cq_ptr != NULL &&
+        ring->map.cq_ptr != ring->map.sq_ptr) {
+        munmap(ring->map.cq_ptr, ring->map.cq_size);
+    }
+    if (ring->map.sq_ptr != NULL) {
+        munmap(ring->map.sq_ptr, ring->map.sq_size);
+    }
+    if (ring->ring_fd >= 0) {
+        close(ring->ring_fd);
+    }
+}
+
+/**
+ * @brief set up the io_uring and map its rings.
+ * 
+ * @param ring engine pointer.
+ * @param entries submission queue size.
+*/
+static bstm_res_t bstm_uring_open(bstm_uring_t *ring, bstm_u32_t entries) {
+    struct io_uring_params params;
+    struct io_uring_rsrc_register reg;
+    bstm_u8_t *sq_ptr;
+    bstm_u8_t *cq_ptr;
+    void *addr;
+
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = bstm_uring_setup(entries, &params);
+    if (ring->ring_fd < 0) {
+        return BSTM_ERR_IO;
+    }
+
+    ring->map.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->map.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->map.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    /* both rings may share a single mapping. */
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->map.cq_size > ring->map.sq_size) {
+            ring->map.sq_size = ring->map.cq_size;
+        }
+        ring->map.cq_size = ring->map.sq_size;
+    }
+
+    addr = mmap(NULL, ring->map.sq_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (addr == MAP_FAILED) {
+        return BSTM_ERR_IO;
+    }
+    ring->map.sq_ptr = addr;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->map.cq_ptr = ring->map.sq_ptr;
+    } else {
+        addr = mmap(NULL, ring->map.cq_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (addr == MAP_FAILED) {
+            return BSTM_ERR_IO;
+        }
+        ring->map.cq_ptr = addr;
+    }
+
+    addr = mmap(NULL, ring->map.sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (addr == MAP_FAILED) {
+        return BSTM_ERR_IO;
+    }
+    ring->sq.sqes = (struct io_uring_sqe *)addr;
+
+    sq_ptr = (bstm_u8_t *)ring->map.sq_ptr;
+    ring->sq.head = (unsigned *)(sq_ptr + params.sq_off.head);
+    ring->sq.tail = (unsigned *)(sq_ptr + params.sq_off.tail);
+    ring->sq.mask = (unsigned *)(sq_ptr + params.sq_off.ring_mask);
+    ring->sq.array = (unsigned *)(sq_ptr + params.sq_off.array);
+    ring->sq.entries = params.sq_entries;
+
+    cq_ptr = (bstm_u8_t *)ring->map.cq_ptr;
+    ring->cq.head = (unsigned *)(cq_ptr + params.cq_off.head);
+    ring->cq.tail = (unsigned *)(cq_ptr + params.cq_off.tail);
+    ring->cq.mask = (unsigned *)(cq_ptr + params.cq_off.ring_mask);
+    ring->cq.cqes = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+
+    /* reserve an empty fixed buffer table, slots are filled on attach. */
+    memset(&reg, 0, sizeof(reg));
+    reg.nr = ring->max_stms;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (bstm_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) < 0) {
+        return BSTM_ERR_IO;
+    }
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief create a new io_uring engine.
+ * 
+ * @note the buffer of each attached byte stream is registered as a fixed
+ *       buffer, so the kernel doesn't map it again for every I/O.
+ * 
+ * @param ring engine pointer.
+ * @param conf configuration pointer.
+ * 
+ * @return BSTM_OK              create engine successfully.
+ *         BSTM_ERR             sq_size isn't between 1 and 32768, or max_stms
+ *                              between 1 and 16384.
+ *         BSTM_ERR_NO_MEM      failed to allocate memory.
+ *         BSTM_ERR_IO          failed to set up the io_uring, see errno.
+*/
+bstm_res_t bstm_uring_new(bstm_uring_t **ring, bstm_uring_conf_t *conf) {
+    bstm_uring_t *alloc_ring;
+    bstm_u32_t sq_size;
+    bstm_u32_t max_stms;
+    bstm_u32_t i;
+    bstm_res_t res;
+
+    BSTM_ASSERT(ring != NULL);
+
+    if (conf != NULL) {
+        sq_size = conf->sq_size;
+        max_stms = conf->max_stms;
+    } else {
+        sq_size = BSTM_URING_DEF_SQ_SIZE;
+        max_stms = BSTM_URING_DEF_MAX_STMS;
+    }
+
+    if (sq_size == 0 ||
+        sq_size > BSTM_URING_MAX_SQ_SIZE ||
+        max_stms == 0 ||
+        max_stms > BSTM_URING_MAX_STMS) {
+        return BSTM_ERR;
+    }
+
+    alloc_ring = (bstm_uring_t *)malloc(sizeof(bstm_uring_t));
+    if (alloc_ring == NULL) {
+        return BSTM_ERR_NO_MEM;
+    }
+    memset(alloc_ring, 0, sizeof(bstm_uring_t));
+    alloc_ring->ring_fd = -1;
+    alloc_ring->max_stms = max_stms;
+
+    alloc_ring->slot = (bstm_uring_slot_t *)calloc(max_stms, sizeof(bstm_uring_slot_t));
+    alloc_ring->free_slot = (bstm_u32_t *)malloc(max_stms * sizeof(bstm_u32_t));
+    if (alloc_ring->slot == NULL ||
+        alloc_ring->free_slot == NULL) {
+        free(alloc_ring->slot);
+        free(alloc_ring->free_slot);
+        free(alloc_ring);
+
+        return BSTM_ERR_NO_MEM;
+    }
+
+    /* lower slots are handed out first. */
+    for (i = 0; i < max_stms; i++) {
+        alloc_ring->free_slot[i] = max_stms - 1 - i;
+    }
+    alloc_ring->free_cnt = max_stms;
+
+    res = bstm_uring_open(alloc_ring, sq_size);
+    if (res != BSTM_OK) {
+        bstm_uring_close(alloc_ring);
+        free(alloc_ring->slot);
+        free(alloc_ring->free_slot);
+        free(alloc_ring);
+
+        return res;
+    }
+
+    *ring = alloc_ring;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief delete the io_uring engine.
+ * 
+ * @note the attached byte streams are left as they are, I/O still in flight
+ *       is cancelled by the kernel.
+ * 
+ * @param ring engine pointer.
+*/
+bstm_res_t bstm_uring_del(bstm_uring_t *ring) {
+    BSTM_ASSERT(ring != NULL);
+
+    bstm_uring_close(ring);
+    free(ring->slot);
+    free(ring->free_slot);
+    free(ring);
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief attach a byte stream to the engine.
+ * 
+ * @note the buffer of the byte stream must stay where it is while attached.
+ * 
+ * @param ring engine pointer.
+ * @param ctx context pointer.
+ * @param user user data reported with the events of this byte stream.
+ * @param slot slot pointer, identifies the byte stream in later calls.
+ * 
+ * @return BSTM_OK              attach byte stream successfully.
+ *         BSTM_ERR             the buffer of a growable byte stream can't be
+ *                              registered.
+ *         BSTM_ERR_NO_SPACE    max_stms byte streams are attached already.
+ *         BSTM_ERR_IO          failed to register the buffer, see errno.
+*/
+bstm_res_t bstm_uring_attach(bstm_uring_t *ring, bstm_ctx_t *ctx, void *user, bstm_u32_t *slot) {
+    bstm_span_t buff;
+    bstm_u32_t idx;
+    bstm_res_t res;
+
+    BSTM_ASSERT(ring != NULL);
+    BSTM_ASSERT(ctx != NULL);
+    BSTM_ASSERT(slot != NULL);
+
+    if (ring->free_cnt == 0) {
+        return BSTM_ERR_NO_SPACE;
+    }
+    idx = ring->free_slot[ring->free_cnt - 1];
+
+    res = bstm_get_buff(ctx, &buff);
+    if (res != BSTM_OK) {
+        return res;
+    }
+
+    res = bstm_uring_set_buff(ring, idx, buff.data, buff.size);
+    if (res != BSTM_OK) {
+        return res;
+    }
+
+    ring->free_cnt--;
+    ring->slot[idx].ctx = ctx;
+    ring->slot[idx].user = user;
+    ring->slot[idx].busy = 0;
+    *slot = idx;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief detach a byte stream from the engine.
+ * 
+ * @param ring engine pointer.
+ * @param slot slot index.
+ * 
+ * @return BSTM_OK              detach byte stream successfully.
+ *         BSTM_ERR             the slot is free, or I/O is still in flight.
+ *         BSTM_ERR_IO          failed to unregister the buffer, see errno.
+*/
+bstm_res_t bstm_uring_detach(bstm_uring_t *ring, bstm_u32_t slot) {
+    bstm_res_t res;
+
+    BSTM_ASSERT(ring != NULL);
+
+    if (slot >= ring->max_stms ||
+        ring->slot[slot].ctx == NULL ||
+        ring->slot[slot].busy != 0) {
+        return BSTM_ERR;
+    }
+
+    res = bstm_uring_set_buff(ring, slot, NULL, 0);
+    if (res != BSTM_OK) {
+        return res;
+    }
+
+    ring->slot[slot].ctx = NULL;
+    ring->slot[slot].user = NULL;
+    ring->free_slot[ring->free_cnt++] = slot;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief get a submission queue entry, submitting the queued ones if full.
+ * 
+ * @param ring engine pointer.
+*/
+static struct io_uring_sqe *bstm_uring_get_sqe(bstm_uring_t *ring) {
+    unsigned tail;
+
+    tail = *ring->sq.tail;
+    if (tail - __atomic_load_n(ring->sq.head, __ATOMIC_ACQUIRE) >= ring->sq.entries) {
+        if (bstm_uring_submit(ring, 0) != BSTM_OK ||
+            tail - __atomic_load_n(ring->sq.head, __ATOMIC_ACQUIRE) >= ring->sq.entries) {
+            return NULL;
+        }
+    }
+
+    return &ring->sq.sqes[tail & *ring->sq.mask];
+}
+
+/**
+ * @brief queue a fixed buffer I/O on a byte stream.
+ * 
+ * @param ring engine pointer.
+ * @param slot slot index.
+ * @param fd file descriptor.
+ * @param op kind of I/O.
+ * @param data start of the buffer region.
+ * @param size size of the buffer region.
+*/
+static bstm_res_t bstm_uring_queue(bstm_uring_t *ring, bstm_u32_t slot, int fd,
+                                   bstm_uring_op_t op, const void *data, bstm_size_t size) {
+    struct io_uring_sqe *sqe;
+    unsigned tail;
+
+    sqe = bstm_uring_get_sqe(ring);
+    if (sqe == NULL) {
+        return BSTM_ERR_IO;
+    }
+
+#ifdef BSTM_SIZE_64
+    /* the length of a single transfer is 32 bits, the rest goes next time. */
+    if (size > BSTM_URING_MAX_IO) {
+        size = BSTM_URING_MAX_IO;
+    }
+#endif
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = op == BSTM_URING_FILL ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->off = (__u64)-1;
+    sqe->addr = (__u64)(uintptr_t)data;
+    sqe->len = size;
+    sqe->buf_index = (__u16)slot;
+    sqe->user_data = ((__u64)slot << 1) | op;
+
+    tail = *ring->sq.tail;
+    ring->sq.array[tail & *ring->sq.mask] = tail & *ring->sq.mask;
+    __atomic_store_n(ring->sq.tail, tail + 1, __ATOMIC_RELEASE);
+    ring->sq.pending++;
+    ring->slot[slot].busy |= 1u << op;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief queue a fill of a byte stream from a file descriptor.
+ * 
+ * @note the read goes straight into the free space up to the end of the
+ *       buffer, wrapped free space is filled by the next one. the byte
+ *       stream must not be written otherwise until the fill completes.
+ * 
+ * @param ring engine pointer.
+ * @param slot slot index.
+ * @param fd file descriptor.
+ * 
+ * @return BSTM_OK              queue fill successfully.
+ *         BSTM_ERR             the slot is free, or a fill is in flight, or
+ *                              the library is built in MPSC mode.
+ *         BSTM_ERR_NO_SPACE    the byte stream has no free space.
+ *         BSTM_ERR_IO          failed to submit queued I/O, see errno.
+*/
+bstm_res_t bstm_uring_fill(bstm_uring_t *ring, bstm_u32_t slot, int fd) {
+    bstm_span_t span[2];
+    bstm_res_t res;
+
+    BSTM_ASSERT(ring != NULL);
+
+    if (slot >= ring->max_stms ||
+        ring->slot[slot].ctx == NULL ||
+        (ring->slot[slot].busy & (1u << BSTM_URING_FILL))) {
+        return BSTM_ERR;
+    }
+
+    res = bstm_write_reserve(ring->slot[slot].ctx, span, 0);
+    if (res != BSTM_OK) {
+        return res;
+    }
+
+    return bstm_uring_queue(ring, slot, fd, BSTM_URING_FILL, span[0].data, span[0].size);
+}
+
+/**
+ * @brief queue a drain of a byte stream to a file descriptor.
+ * 
+ * @note the write goes straight from the data up to the end of the buffer,
+ *       wrapped data is drained by the next one. the byte stream must not be
+ *       read otherwise until the drain completes.
+ * 
+ * @param ring engine pointer.
+ * @param slot slot index.
+ * @param fd file descriptor.
+ * 
+ * @return BSTM_OK              queue drain successfully.
+ *         BSTM_ERR             the slot is free, or a drain is in flight.
+ *         BSTM_ERR_NO_DATA     the byte stream has no data.
+ *         BSTM_ERR_IO          failed to submit queued I/O, see errno.
+*/
+bstm_res_t bstm_uring_drain(bstm_uring_t *ring, bstm_u32_t slot, int fd) {
+    bstm_cspan_t span[2];
+    bstm_res_t res;
+
+    BSTM_ASSERT(ring != NULL);
+
+    if (slot >= ring->max_stms ||
+        ring->slot[slot].ctx == NULL ||
+        (ring->slot[slot].busy & (1u << BSTM_URING_DRAIN))) {
+        return BSTM_ERR;
+    }
+
+    res = bstm_read_acquire(ring->slot[slot].ctx, span, 0);
+    if (res != BSTM_OK) {
+        return res;
+    }
+
+    return bstm_uring_queue(ring, slot, fd, BSTM_URING_DRAIN, span[0].data, span[0].size);
+}
+
+/**
+ * @brief submit the queued I/O in a single system call.
+ * 
+ * @param ring engine pointer.
+ * @param wait_nr number of completions to wait for, 0 to return at once.
+ * 
+ * @return BSTM_OK              submit I/O successfully.
+ *         BSTM_ERR_IO          io_uring_enter() failed, see errno.
+*/
+bstm_res_t bstm_uring_submit(bstm_uring_t *ring, bstm_u32_t wait_nr) {
+    int ret;
+
+    BSTM_ASSERT(ring != NULL);
+
+    do {
+        ret = bstm_uring_enter(ring->ring_fd, ring->sq.pending, wait_nr,
+            wait_nr != 0 ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0) {
+        return BSTM_ERR_IO;
+    }
+    ring->sq.pending -= (unsigned)ret;
+
+    return BSTM_OK;
+}
+
+/**
+ * @brief reap completed I/O and apply it to the byte streams.
+ * 
+ * @note a fill commits the bytes read, a drain releases the bytes written.
+ * 
+ * @param ring engine pointer.
+ * @param event event array.
+ * @param max number of events.
+ * @param cnt event number pointer.
+*/
+bstm_res_t bstm_uring_reap(bstm_uring_t *ring, bstm_uring_event_t *event, bstm_u32_t max, bstm_u32_t *cnt) {
+    struct io_uring_cqe *cqe;
+    bstm_uring_slot_t *slot;
+    bstm_uring_op_t op;
+    unsigned head;
+    unsigned tail;
+    bstm_u32_t num;
+
+    BSTM_ASSERT(ring != NULL);
+    BSTM_ASSERT(event != NULL || max == 0);
+    BSTM_ASSERT(cnt != NULL);
+
+    head = *ring->cq.head;
+    tail = __atomic_load_n(ring->cq.tail, __ATOMIC_ACQUIRE);
+    for (num = 0; num < max && head != tail; num++, head++) {
+        cqe = &ring->cq.cqes[head & *ring->cq.mask];
+        slot = &ring->slot[cqe->user_data >> 1];
+        op = (bstm_uring_op_t)(cqe->user_data & 1);
+
+        slot->busy &= ~(1u << op);
+        if (cqe->res > 0) {
+            if (op == BSTM_URING_FILL) {
+                bstm_write_commit(slot->ctx, (bstm_size_t)cqe->res);
+            } else {
+                bstm_read_release(slot->ctx, (bstm_size_t)cqe->res);
+            }
+        }
+
+        event[num].ctx = slot->ctx;
+        event[num].user = slot->user;
+        event[num].op = op;
+        event[num].res = cqe->res;
+    }
+    __atomic_store_n(ring->cq.head, head, __ATOMIC_RELEASE);
+    *cnt = num;
+
+    return BSTM_OK;
+}
@@ -0,0 +1,93 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2023 Alex Chen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __BSTM_URING_H__
+#define __BSTM_URING_H__
+
+#include "bytestream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* io_uring engine filling and draining many byte streams. */
+typedef struct _bstm_uring  bstm_uring_t;
+
+/* configuration of the io_uring engine. */
+typedef struct _bstm_uring_conf {
+
+    /* number of submission queue entries, up to 32768. */
+    bstm_u32_t sq_size;
+
+    /* maximum number of byte streams attached at once, up to 16384. */
+    bstm_u32_t max_stms;
+} bstm_uring_conf_t;
+
+/* kind of I/O on a byte stream. */
+typedef enum _bstm_uring_op {
+
+    /* read from a file descriptor into the free space. */
+    BSTM_URING_FILL     = 0,
+
+    /* write the data to a file descriptor. */
+    BSTM_URING_DRAIN    = 1,
+} bstm_uring_op_t;
+
+/* completed I/O on a byte stream. */
+typedef struct _bstm_uring_event {
+
+    /* context of the byte stream. */
+    bstm_ctx_t *ctx;
+
+    /* user data given when the byte stream was attached. */
+    void *user;
+
+    /* kind of I/O. */
+    bstm_uring_op_t op;
+
+    /* transferred size, 0 for a fill at end of file, or a negative errno. */
+    bstm_s32_t res;
+} bstm_uring_event_t;
+
+bstm_res_t bstm_uring_new(bstm_uring_t **ring, bstm_uring_conf_t *conf);
+
+bstm_res_t bstm_uring_del(bstm_uring_t *ring);
+
+bstm_res_t bstm_uring_attach(bstm_uring_t *ring, bstm_ctx_t *ctx, void *user, bstm_u32_t *slot);
+
+bstm_res_t bstm_uring_detach(bstm_uring_t *ring, bstm_u32_t slot);
+
+bstm_res_t bstm_uring_fill(bstm_uring_t *ring, bstm_u32_t slot, int fd);
+
+bstm_res_t bstm_uring_drain(bstm_uring_t *ring, bstm_u32_t slot, int fd);
+
+bstm_res_t bstm_uring_submit(bstm_uring_t *ring, bstm_u32_t wait_nr);
+
+bstm_res_t bstm_uring_reap(bstm_uring_t *ring, bstm_uring_event_t *event, bstm_u32_t max, bstm_u32_t *cnt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
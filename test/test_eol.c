@@ -0,0 +1,167 @@
+/**
+ * bstm_readline() checked against a byte at a time search, with CR, LF and
+ * CRLF at every offset of the data, and the data starting at every offset of
+ * the buffer, so EOL lands on both sides of the 16 and 32 byte blocks of the
+ * SSE2/AVX2 scanners, of the wrap and of the segments. build it with and
+ * without BSTM_NO_SIMD.
+ * 
+ * gcc -I.. ../bytestream.c test_eol.c -o test_eol && ./test_eol
+ * gcc -DBSTM_NO_SIMD -I.. ../bytestream.c test_eol.c -o test_eol && ./test_eol
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bytestream.h"
+
+#define TEST_DATA_SIZE  100
+
+/**
+ * @brief find the first line in data, one byte at a time.
+ * 
+ * @note a CR ending the data is taken as EOL, as the byte stream does.
+ * 
+ * @param data data pointer.
+ * @param size data size.
+ * 
+ * @return line length, 0 if there is no EOL.
+*/
+static bstm_size_t test_line(const unsigned char *data, bstm_size_t size) {
+    bstm_size_t i;
+
+    for (i = 0; i < size; i++) {
+        if (data[i] == '\n') {
+            return i + 1;
+        }
+        if (data[i] == '\r') {
+            return i + 1 < size && data[i + 1] == '\n' ? i + 2 : i + 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief read all the lines of the byte stream and check them.
+ * 
+ * @param stm context pointer.
+ * @param data data written and not read yet.
+ * @param size data size.
+ * 
+ * @return size of the lines read.
+*/
+static bstm_size_t test_take(bstm_ctx_t *stm, const unsigned char *data, bstm_size_t size) {
+    unsigned char line[TEST_DATA_SIZE];
+    bstm_size_t taken;
+    bstm_size_t expect;
+    bstm_size_t len;
+
+    for (taken = 0; (expect = test_line(data + taken, size - taken)) != 0; taken += len) {
+        assert(bstm_readline(stm, line, sizeof(line), &len) == BSTM_OK);
+        assert(len == expect);
+        assert(memcmp(line, data + taken, len) == 0);
+    }
+    assert(bstm_readline(stm, line, sizeof(line), &len) == BSTM_ERR_NO_EOL);
+
+    return taken;
+}
+
+/**
+ * @brief empty the byte stream and move its head to an offset.
+ * 
+ * @param stm context pointer.
+ * @param offs offset.
+*/
+static void test_seek(bstm_ctx_t *stm, bstm_size_t offs) {
+    static const unsigned char skip[256];
+    bstm_size_t size;
+
+    assert(bstm_clear(stm) == BSTM_OK);
+    for (; offs != 0; offs -= size) {
+        size = offs < sizeof(skip) ? offs : sizeof(skip);
+        assert(bstm_write(stm, skip, size) == BSTM_OK);
+        assert(bstm_read_release(stm, size) == BSTM_OK);
+    }
+}
+
+/**
+ * @brief put EOL at every offset of data written from every offset of a range.
+ * 
+ * @param stm context pointer.
+ * @param first first offset.
+ * @param last last offset.
+*/
+static void test_scan(bstm_ctx_t *stm, bstm_size_t first, bstm_size_t last) {
+    static const char *const eol[] = { "\r", "\n", "\r\n" };
+    unsigned char data[TEST_DATA_SIZE];
+    bstm_size_t offs;
+    bstm_size_t size;
+    bstm_size_t pos;
+    bstm_size_t i;
+    int kind;
+
+    for (offs = first; offs <= last; offs++) {
+        for (kind = 0; kind < 3; kind++) {
+            for (pos = 0; pos + strlen(eol[kind]) <= TEST_DATA_SIZE; pos++) {
+
+                /* bytes next to CR and LF, or with their high bit set. */
+                for (i = 0; i < TEST_DATA_SIZE; i++) {
+                    data[i] = (unsigned char)"\x09\x0b\x0c\x0e\x8a\x8d\xff a"[i % 9];
+                }
+                memcpy(data + pos, eol[kind], strlen(eol[kind]));
+
+                /* written at once. */
+                test_seek(stm, offs);
+                assert(bstm_write(stm, data, TEST_DATA_SIZE) == BSTM_OK);
+                assert(test_take(stm, data, TEST_DATA_SIZE) == pos + strlen(eol[kind]));
+
+                /* written a byte at a time, so the scan picks up where it stopped. */
+                test_seek(stm, offs);
+                for (i = 0, size = 0; size < TEST_DATA_SIZE; size++) {
+                    assert(bstm_write(stm, data + size, 1) == BSTM_OK);
+                    i += test_take(stm, data + i, size + 1 - i);
+                }
+                assert(i == pos + strlen(eol[kind]));
+            }
+        }
+    }
+}
+
+int main(void) {
+    bstm_pool_t *pool;
+    bstm_ctx_t *stm;
+    bstm_conf_t conf;
+    bstm_stat_t stat;
+
+    /* the data wraps around the end of the buffer from offset 29 on. */
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 128;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+    test_scan(stm, 0, 127);
+    bstm_del(stm);
+
+    /* the mirror keeps the data in one piece across the wrap. */
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 128;
+    conf.flags = BSTM_CONF_MIRROR;
+    if (bstm_new(&stm, &conf) == BSTM_OK) {
+        assert(bstm_stat(stm, &stat) == BSTM_OK);
+        test_scan(stm, stat.cap_size - 128, stat.cap_size - 1);
+        bstm_del(stm);
+    }
+
+    /* the data spans segments of 48 bytes. */
+    assert(bstm_pool_new(&pool, 48) == BSTM_OK);
+    memset(&conf, 0, sizeof(conf));
+    conf.flags = BSTM_CONF_CHAIN;
+    conf.pool = pool;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+    test_scan(stm, 0, 95);
+    bstm_del(stm);
+    bstm_pool_del(pool);
+
+    printf("test_eol: ok\n");
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * round trip through a socketpair with bstm_fill_from_fd() and
+ * bstm_drain_to_fd(), wrapping around the ring buffer, and fills reading
+ * nothing into a byte stream borrowing its buffer from a pool.
+ * 
+ * gcc -I.. ../bytestream.c test_fd_io.c -o test_fd_io && ./test_fd_io
+*/
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bytestream.h"
+
+#define TEST_SIZE   100000
+
+static unsigned char send_buff[TEST_SIZE];
+static unsigned char recv_buff[TEST_SIZE];
+
+/**
+ * @brief check that a fill reading nothing gives a borrowed buffer back.
+ * 
+ * @param fd file descriptor with nothing to read, or at end of file.
+ * @param res expected result of the fill.
+*/
+static void test_fill_empty(int fd, bstm_res_t res) {
+    bstm_pool_t *pool;
+    bstm_ctx_t *stm;
+    bstm_ctx_t *other;
+    bstm_conf_t conf;
+    bstm_span_t span[2];
+    bstm_cspan_t cspan[2];
+    bstm_size_t len;
+    bstm_u8_t *buff;
+
+    assert(bstm_pool_new(&pool, 256) == BSTM_OK);
+    memset(&conf, 0, sizeof(conf));
+    conf.pool = pool;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+    assert(bstm_new(&other, &conf) == BSTM_OK);
+
+    /* a cancelled reservation gives the segment back. */
+    assert(bstm_write_reserve(stm, span, 0) == BSTM_OK);
+    buff = span[0].data;
+    assert(bstm_write_cancel(stm) == BSTM_OK);
+
+    /* so does a fill reading nothing, the next borrower gets the segment. */
+    assert(bstm_fill_from_fd(stm, fd, &len) == res);
+    assert(bstm_write(other, "x", 1) == BSTM_OK);
+    assert(bstm_read_acquire(other, cspan, 1) == BSTM_OK);
+    assert(cspan[0].data == buff);
+
+    bstm_del(other);
+    bstm_del(stm);
+    bstm_pool_del(pool);
+}
+
+int main(void) {
+    bstm_ctx_t *stm;
+    bstm_conf_t conf;
+    bstm_size_t len;
+    bstm_res_t res;
+    size_t send_size;
+    size_t recv_size;
+    ssize_t ret;
+    int fds[2];
+    int i;
+
+    for (i = 0; i < TEST_SIZE; i++) {
+        send_buff[i] = (unsigned char)(i * 7 + i / 251);
+    }
+
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    assert(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+    assert(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+
+    /* an odd capacity makes the data wrap at odd offsets. */
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 777;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+
+    /* nothing to read yet. */
+    assert(bstm_fill_from_fd(stm, fds[0], &len) == BSTM_ERR_AGAIN);
+    test_fill_empty(fds[0], BSTM_ERR_AGAIN);
+
+    /* fds[1] -> fds[0] -> byte stream -> fds[0] -> fds[1]. */
+    send_size = 0;
+    recv_size = 0;
+    while (recv_size < TEST_SIZE) {
+        if (send_size < TEST_SIZE) {
+            ret = write(fds[1], send_buff + send_size, TEST_SIZE - send_size);
+            if (ret > 0) {
+                send_size += (size_t)ret;
+            }
+        }
+
+        res = bstm_fill_from_fd(stm, fds[0], &len);
+        assert(res == BSTM_OK || res == BSTM_ERR_AGAIN || res == BSTM_ERR_NO_SPACE);
+
+        res = bstm_drain_to_fd(stm, fds[0], &len);
+        assert(res == BSTM_OK || res == BSTM_ERR_AGAIN || res == BSTM_ERR_NO_DATA);
+
+        ret = read(fds[1], recv_buff + recv_size, TEST_SIZE - recv_size);
+        if (ret > 0) {
+            recv_size += (size_t)ret;
+        }
+    }
+    assert(memcmp(send_buff, recv_buff, TEST_SIZE) == 0);
+
+    /* end of file reads as 0 bytes. */
+    close(fds[1]);
+    assert(bstm_fill_from_fd(stm, fds[0], &len) == BSTM_OK);
+    assert(len == 0);
+    test_fill_empty(fds[0], BSTM_OK);
+
+    bstm_del(stm);
+    close(fds[0]);
+
+    printf("test_fd_io: ok\n");
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+/**
+ * bstm::ring<> writing, reading, peeking and reading lines across the wrap,
+ * and bstm::streambuf formatting into and parsing out of a byte stream across
+ * the wrap, giving back a borrowed buffer reserved for a put area left unused.
+ * 
+ * gcc -c -I.. ../bytestream.c && g++ -I.. bytestream.o test_hpp.cpp -o test_hpp && ./test_hpp
+*/
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include "bytestream.hpp"
+
+/**
+ * @brief stream buffer able to leave its put area unused.
+*/
+class test_streambuf : public bstm::streambuf {
+public:
+
+    explicit test_streambuf(bstm_ctx_t *ctx) noexcept : bstm::streambuf(ctx) {}
+
+    /**
+     * @brief move the put area on, and take the character put back.
+    */
+    void reserve() {
+        assert(!traits_type::eq_int_type(overflow('x'), traits_type::eof()));
+        pbump(-1);
+    }
+};
+
+/**
+ * @brief get where the data of a pool-lent byte stream lives.
+ * 
+ * @param stm context pointer.
+*/
+static const bstm_u8_t *test_buff(bstm_ctx_t *stm) {
+    bstm_cspan_t span[2];
+
+    assert(bstm_read_acquire(stm, span, 1) == BSTM_OK);
+
+    return span[0].data;
+}
+
+static void test_ring() {
+    bstm::ring<100> stm;
+    unsigned char data[128];
+    char line[16];
+    bstm_size_t len;
+    int i;
+
+    /* the capacity is rounded up to a power of two. */
+    static_assert(bstm::ring<100>::cap_size == 128, "capacity isn't rounded up");
+    for (i = 0; i < 128; i++) {
+        data[i] = (unsigned char)i;
+    }
+    assert(stm.write(data, 128) == BSTM_OK);
+    assert(stm.write(data, 1) == BSTM_ERR_NO_SPACE);
+    assert(stm.free_size() == 0);
+
+    /* the data wraps around the end of the buffer. */
+    assert(stm.read(data, 100) == BSTM_OK);
+    assert(data[99] == 99);
+    assert(stm.write("abc\r\ndef\n", 9) == BSTM_OK);
+    assert(stm.peek(data, 28, 2) == BSTM_OK);
+    assert(data[0] == 'a' && data[1] == 'b');
+    assert(stm.read(data, 28) == BSTM_OK);
+    assert(data[27] == 127);
+    assert(stm.readline(line, sizeof(line), &len) == BSTM_OK);
+    assert(len == 5 && std::memcmp(line, "abc\r\n", 5) == 0);
+
+    /* a moved from byte stream is left empty. */
+    bstm::ring<100> other(std::move(stm));
+    assert(stm.used_size() == 0);
+    assert(other.used_size() == 4);
+    assert(other.readline(line, sizeof(line), &len) == BSTM_OK);
+    assert(len == 4 && std::memcmp(line, "def\n", 4) == 0);
+    assert(other.readline(line, sizeof(line), &len) == BSTM_ERR_NO_EOL);
+}
+
+static void test_stream() {
+    bstm_conf_t conf;
+    bstm_stat_t stat;
+    bstm_ctx_t *ctx;
+    std::string word;
+    int round;
+    int num;
+
+    std::memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 64;
+    assert(bstm_new(&ctx, &conf) == BSTM_OK);
+
+    /* enough rounds for the areas to wrap several times. */
+    for (round = 0; round < 100; round++) {
+        bstm::streambuf sb(ctx);
+        std::ostream os(&sb);
+        std::istream is(&sb);
+
+        /* short of the wrap, written data becomes readable on flush. */
+        os << "round " << round << ' ';
+        assert(bstm_stat(ctx, &stat) == BSTM_OK);
+        assert(round != 0 || stat.used_size == 0);
+        os << std::endl;
+        assert(is >> word >> num);
+        assert(word == "round" && num == round);
+        assert(is.get() == ' ');
+        assert(is.get() == '\n');
+        assert(is.get() == std::istream::traits_type::eof());
+    }
+
+    /* a full byte stream fails the write. */
+    {
+        bstm::streambuf sb(ctx);
+        std::ostream os(&sb);
+
+        os << std::string(100, 'x') << std::flush;
+        assert(!os);
+    }
+    assert(bstm_read(ctx, NULL, 64) == BSTM_OK);
+    bstm_del(ctx);
+}
+
+static void test_cancel() {
+    const bstm_u8_t *buff;
+    bstm_pool_t *pool;
+    bstm_ctx_t *ctx[2];
+    bstm_conf_t conf;
+
+    assert(bstm_pool_new(&pool, 64) == BSTM_OK);
+    std::memset(&conf, 0, sizeof(conf));
+    conf.pool = pool;
+    assert(bstm_new(&ctx[0], &conf) == BSTM_OK);
+    assert(bstm_new(&ctx[1], &conf) == BSTM_OK);
+    assert(bstm_write(ctx[1], "a", 1) == BSTM_OK);
+    buff = test_buff(ctx[1]);
+    assert(bstm_read(ctx[1], NULL, 1) == BSTM_OK);
+
+    /* the segment borrowed for an unused put area goes back on sync. */
+    {
+        test_streambuf sb(ctx[0]);
+
+        sb.reserve();
+        assert(sb.pubsync() == 0);
+        assert(bstm_write(ctx[1], "b", 1) == BSTM_OK);
+        assert(test_buff(ctx[1]) == buff);
+        assert(bstm_read(ctx[1], NULL, 1) == BSTM_OK);
+
+        /* and on destruction. */
+        sb.reserve();
+    }
+    assert(bstm_write(ctx[1], "c", 1) == BSTM_OK);
+    assert(test_buff(ctx[1]) == buff);
+
+    bstm_del(ctx[1]);
+    bstm_del(ctx[0]);
+    bstm_pool_del(pool);
+}
+
+int main() {
+    test_ring();
+    test_stream();
+    test_cancel();
+
+    std::printf("test_hpp: ok\n");
+
+    return 0;
+}
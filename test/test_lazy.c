@@ -0,0 +1,240 @@
+/**
+ * BSTM_CONF_LAZY buffers allocated on the first write and freed once read
+ * empty, cleared or given up, again and again, kept by idle_time until
+ * bstm_shrink() finds them idle long enough, and combined with
+ * BSTM_CONF_OVERWRITE, along with the accounting of the data dropped. the
+ * memory blocks allocated are counted to see the buffer come and go.
+ * 
+ * gcc -I.. ../bytestream.c test_lazy.c -o test_lazy && ./test_lazy
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bytestream.h"
+
+extern void *__libc_malloc(size_t size);
+extern void __libc_free(void *ptr);
+
+static int block_cnt;
+
+/**
+ * @brief count the memory blocks allocated, then allocate.
+ * 
+ * @param size block size.
+*/
+void *malloc(size_t size) {
+    void *ptr;
+
+    ptr = __libc_malloc(size);
+    if (ptr != NULL) {
+        block_cnt++;
+    }
+
+    return ptr;
+}
+
+/**
+ * @brief count the memory blocks freed, then free.
+ * 
+ * @param ptr block pointer.
+*/
+void free(void *ptr) {
+    if (ptr != NULL) {
+        block_cnt--;
+    }
+    __libc_free(ptr);
+}
+
+/**
+ * @brief check the size of the data kept and dropped.
+ * 
+ * @param stm context pointer.
+ * @param used_size used size expected.
+ * @param drop_size dropped size expected.
+*/
+static void test_stat(bstm_ctx_t *stm, bstm_size_t used_size, bstm_u64_t drop_size) {
+    bstm_stat_t stat;
+
+    assert(bstm_stat(stm, &stat) == BSTM_OK);
+    assert(stat.used_size == used_size);
+    assert(stat.drop_size == drop_size);
+}
+
+static void test_cycle(void) {
+    unsigned char buff[16];
+    bstm_span_t span[2];
+    bstm_conf_t conf;
+    bstm_stat_t stat;
+    bstm_ctx_t *stm;
+    int base;
+    int i;
+
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 16;
+    conf.flags = BSTM_CONF_LAZY;
+    base = block_cnt;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+
+    /* only the context until the first write. */
+    base++;
+    assert(block_cnt == base);
+    assert(bstm_stat(stm, &stat) == BSTM_OK);
+    assert(stat.cap_size == 16);
+
+    for (i = 0; i < 100; i++) {
+
+        /* read empty, the buffer goes and the data starts over. */
+        assert(bstm_write(stm, "0123456789", 10) == BSTM_OK);
+        assert(block_cnt == base + 1);
+        assert(bstm_read(stm, buff, 4) == BSTM_OK);
+        assert(block_cnt == base + 1);
+        assert(bstm_write(stm, "abcdefghij", 10) == BSTM_OK);
+        assert(bstm_read(stm, buff, 16) == BSTM_OK);
+        assert(memcmp(buff, "456789abcdefghij", 16) == 0);
+        assert(block_cnt == base);
+
+        /* cleared. */
+        assert(bstm_write(stm, "x", 1) == BSTM_OK);
+        assert(block_cnt == base + 1);
+        assert(bstm_clear(stm) == BSTM_OK);
+        assert(block_cnt == base);
+
+        /* reserved and given up. */
+        assert(bstm_write_reserve(stm, span, 1) == BSTM_OK);
+        assert(block_cnt == base + 1);
+        assert(bstm_write_cancel(stm) == BSTM_OK);
+        assert(block_cnt == base);
+
+        /* reserved and committed. */
+        assert(bstm_write_reserve(stm, span, 1) == BSTM_OK);
+        span[0].data[0] = 'y';
+        assert(bstm_write_commit(stm, 1) == BSTM_OK);
+        assert(bstm_read(stm, buff, 1) == BSTM_OK);
+        assert(buff[0] == 'y');
+        assert(block_cnt == base);
+    }
+
+    /* deleted with and without a buffer. */
+    bstm_del(stm);
+    assert(block_cnt == base - 1);
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+    assert(bstm_write(stm, "z", 1) == BSTM_OK);
+    bstm_del(stm);
+    assert(block_cnt == base - 1);
+}
+
+static void test_idle(void) {
+    unsigned char buff[4];
+    bstm_conf_t conf;
+    bstm_ctx_t *stm;
+    int base;
+
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 16;
+    conf.flags = BSTM_CONF_LAZY;
+    conf.idle_time = 100;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+    base = block_cnt;
+
+    /* a busy byte stream keeps its buffer. */
+    assert(bstm_write(stm, "abcd", 4) == BSTM_OK);
+    assert(block_cnt == base + 1);
+    usleep(120000);
+    assert(bstm_shrink(stm) == BSTM_OK);
+    assert(block_cnt == base + 1);
+
+    /* so does one empty for less than idle_time. */
+    assert(bstm_read(stm, buff, 4) == BSTM_OK);
+    assert(block_cnt == base + 1);
+    assert(bstm_shrink(stm) == BSTM_OK);
+    assert(block_cnt == base + 1);
+
+    /* the idle time starts over when it's read empty again. */
+    usleep(60000);
+    assert(bstm_write(stm, "efgh", 4) == BSTM_OK);
+    assert(bstm_read(stm, buff, 4) == BSTM_OK);
+    usleep(60000);
+    assert(bstm_shrink(stm) == BSTM_OK);
+    assert(block_cnt == base + 1);
+
+    /* idle long enough, the buffer goes, and comes back on the next write. */
+    usleep(60000);
+    assert(bstm_shrink(stm) == BSTM_OK);
+    assert(block_cnt == base);
+    assert(bstm_shrink(stm) == BSTM_OK);
+    assert(block_cnt == base);
+    assert(bstm_write(stm, "ijkl", 4) == BSTM_OK);
+    assert(block_cnt == base + 1);
+    assert(bstm_read(stm, buff, 4) == BSTM_OK);
+    assert(memcmp(buff, "ijkl", 4) == 0);
+
+    bstm_del(stm);
+}
+
+static void test_overwrite(void) {
+    unsigned char buff[40];
+    bstm_conf_t conf;
+    bstm_ctx_t *stm;
+    int base;
+    int i;
+
+    for (i = 0; i < 40; i++) {
+        buff[i] = (unsigned char)('A' + i);
+    }
+
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 16;
+    conf.flags = BSTM_CONF_LAZY | BSTM_CONF_OVERWRITE;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+    base = block_cnt;
+
+    /* only the end of a write larger than the capacity is kept. */
+    assert(bstm_write(stm, buff, 40) == BSTM_OK);
+    assert(block_cnt == base + 1);
+    test_stat(stm, 16, 24);
+
+    /* dropping all the data to make room keeps the buffer working. */
+    assert(bstm_write(stm, "0123456789abcdef", 16) == BSTM_OK);
+    test_stat(stm, 16, 40);
+    assert(bstm_write(stm, "gh", 2) == BSTM_OK);
+    test_stat(stm, 16, 42);
+    assert(bstm_read(stm, buff, 16) == BSTM_OK);
+    assert(memcmp(buff, "23456789abcdefgh", 16) == 0);
+    assert(block_cnt == base);
+
+    /* a fitting write drops nothing. */
+    assert(bstm_write(stm, "ijkl", 4) == BSTM_OK);
+    test_stat(stm, 4, 42);
+    assert(bstm_clear(stm) == BSTM_OK);
+    bstm_del(stm);
+
+    /* whole lines are dropped. */
+    conf.flags = BSTM_CONF_LAZY | BSTM_CONF_OVERWRITE | BSTM_CONF_SNAP_LINE;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+    assert(bstm_write(stm, "one\ntwo\nthree\n", 14) == BSTM_OK);
+    assert(bstm_write(stm, "four\n", 5) == BSTM_OK);
+    test_stat(stm, 15, 4);
+    assert(bstm_read(stm, buff, 15) == BSTM_OK);
+    assert(memcmp(buff, "two\nthree\nfour\n", 15) == 0);
+    assert(block_cnt == base);
+
+    /* nothing is dropped when there is no line to drop. */
+    assert(bstm_write(stm, "0123456789abcdef", 16) == BSTM_OK);
+    assert(bstm_write(stm, "g\n", 2) == BSTM_ERR_NO_SPACE);
+    assert(bstm_write(stm, buff, 17) == BSTM_ERR_NO_SPACE);
+    test_stat(stm, 16, 4);
+    bstm_del(stm);
+}
+
+int main(void) {
+    test_cycle();
+    test_idle();
+    test_overwrite();
+
+    printf("test_lazy: ok\n");
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * watermark callbacks and readiness notification on both sides of
+ * bstm_move(), when whole segments are relinked between chains and when the
+ * data is copied.
+ * 
+ * gcc -I.. ../bytestream.c test_move.c -o test_move && ./test_move
+*/
+
+#include <assert.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bytestream.h"
+
+#define TEST_SEG_SIZE   16
+
+static int high_cnt[2];
+static int low_cnt[2];
+
+static void on_mark(bstm_ctx_t *ctx, bstm_mark_t mark, void *arg) {
+    int side;
+
+    (void)ctx;
+
+    side = (int)(size_t)arg;
+    if (mark == BSTM_MARK_HIGH) {
+        high_cnt[side]++;
+    } else {
+        low_cnt[side]++;
+    }
+}
+
+/**
+ * @brief check if a file descriptor is readable.
+ * 
+ * @param fd file descriptor.
+*/
+static int readable(int fd) {
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    return poll(&pfd, 1, 0) == 1;
+}
+
+/**
+ * @brief move 32 of 36 bytes from one byte stream to another.
+ * 
+ * @param pool segment pool, NULL for ring buffers.
+*/
+static void test_move(bstm_pool_t *pool) {
+    unsigned char data[36];
+    bstm_ctx_t *src;
+    bstm_ctx_t *dst;
+    bstm_conf_t conf;
+    int src_fd[2];
+    int dst_fd[2];
+    int i;
+
+    for (i = 0; i < 36; i++) {
+        data[i] = (unsigned char)i;
+    }
+    memset(high_cnt, 0, sizeof(high_cnt));
+    memset(low_cnt, 0, sizeof(low_cnt));
+
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = pool != NULL ? 0 : 100;
+    conf.flags = pool != NULL ? BSTM_CONF_CHAIN : 0;
+    conf.pool = pool;
+    conf.high_mark = 20;
+    conf.low_mark = 4;
+    conf.mark_cb = on_mark;
+    conf.mark_arg = (void *)0;
+    assert(bstm_new(&src, &conf) == BSTM_OK);
+    conf.mark_arg = (void *)1;
+    assert(bstm_new(&dst, &conf) == BSTM_OK);
+
+    /* the read fds are readable from 10 bytes of data on. */
+    assert(bstm_notify_open(src, 10, 1, &src_fd[0], &src_fd[1]) == BSTM_OK);
+    assert(bstm_notify_open(dst, 10, 1, &dst_fd[0], &dst_fd[1]) == BSTM_OK);
+
+    assert(bstm_write(src, data, 36) == BSTM_OK);
+    assert(high_cnt[0] == 1);
+    assert(readable(src_fd[0]));
+    assert(!readable(dst_fd[0]));
+
+    /* two whole segments in chain mode, a copy otherwise. */
+    assert(bstm_move(dst, src, 32) == BSTM_OK);
+    assert(low_cnt[0] == 1);
+    assert(high_cnt[1] == 1);
+    assert(low_cnt[1] == 0);
+    assert(!readable(src_fd[0]));
+    assert(readable(dst_fd[0]));
+
+    assert(bstm_read(dst, data, 32) == BSTM_OK);
+    for (i = 0; i < 32; i++) {
+        assert(data[i] == (unsigned char)i);
+    }
+    assert(low_cnt[1] == 1);
+    assert(!readable(dst_fd[0]));
+
+    bstm_del(dst);
+    bstm_del(src);
+}
+
+int main(void) {
+    bstm_pool_t *pool;
+
+    test_move(NULL);
+
+    assert(bstm_pool_new(&pool, TEST_SEG_SIZE) == BSTM_OK);
+    test_move(pool);
+    bstm_pool_del(pool);
+
+    printf("test_move: ok\n");
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * producer threads writing numbered records at once in MPSC mode, read back
+ * by a single consumer that checks every record is whole and every producer's
+ * records come in order.
+ * 
+ * gcc -DBSTM_MPSC -I.. ../bytestream.c test_mpsc.c -o test_mpsc -lpthread && ./test_mpsc
+*/
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bytestream.h"
+
+#ifndef BSTM_MPSC
+#error "build with -DBSTM_MPSC."
+#endif
+
+#define TEST_PRODUCERS  4
+#define TEST_RECORDS    50000
+
+/* producer, sequence number (4 bytes), payload size. */
+#define TEST_HEAD_SIZE  6
+
+static bstm_ctx_t *stm;
+
+/**
+ * @brief get a byte of the payload of a record.
+ * 
+ * @param prod producer.
+ * @param seq sequence number.
+ * @param i position in the payload.
+*/
+static unsigned char test_byte(unsigned int prod, unsigned int seq, unsigned int i) {
+    return (unsigned char)(seq * 31 + prod * 7 + i);
+}
+
+static void *produce(void *arg) {
+    unsigned char rec[TEST_HEAD_SIZE + 64];
+    unsigned int prod;
+    unsigned int seq;
+    unsigned int size;
+    unsigned int i;
+
+    prod = (unsigned int)(size_t)arg;
+    for (seq = 0; seq < TEST_RECORDS; ) {
+        size = (seq + prod) % 64;
+        rec[0] = (unsigned char)prod;
+        rec[1] = (unsigned char)seq;
+        rec[2] = (unsigned char)(seq >> 8);
+        rec[3] = (unsigned char)(seq >> 16);
+        rec[4] = (unsigned char)(seq >> 24);
+        rec[5] = (unsigned char)size;
+        for (i = 0; i < size; i++) {
+            rec[TEST_HEAD_SIZE + i] = test_byte(prod, seq, i);
+        }
+
+        /* the whole record goes in one write. */
+        if (bstm_write(stm, rec, TEST_HEAD_SIZE + size) != BSTM_OK) {
+            sched_yield();
+            continue;
+        }
+        seq++;
+    }
+
+    return NULL;
+}
+
+int main(void) {
+    unsigned char rec[TEST_HEAD_SIZE + 64];
+    unsigned int next[TEST_PRODUCERS];
+    pthread_t thread[TEST_PRODUCERS];
+    bstm_span_t span[2];
+    bstm_conf_t conf;
+    bstm_stat_t stat;
+    bstm_size_t len;
+    unsigned int total;
+    unsigned int prod;
+    unsigned int seq;
+    unsigned int size;
+    unsigned int i;
+    int fds[2];
+
+    /* the capacity is a power of two in MPSC mode anyway. */
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 1024;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+
+    /* writing in place would take space without a claim. */
+    assert(bstm_write_reserve(stm, span, 0) == BSTM_ERR);
+    assert(bstm_write_commit(stm, 1) == BSTM_ERR);
+    assert(pipe(fds) == 0);
+    assert(bstm_fill_from_fd(stm, fds[0], &len) == BSTM_ERR);
+    close(fds[0]);
+    close(fds[1]);
+
+    for (prod = 0; prod < TEST_PRODUCERS; prod++) {
+        next[prod] = 0;
+        assert(pthread_create(&thread[prod], NULL, produce, (void *)(size_t)prod) == 0);
+    }
+
+    for (total = 0; total < TEST_PRODUCERS * TEST_RECORDS; total++) {
+        while (bstm_peek(stm, rec, 0, TEST_HEAD_SIZE) != BSTM_OK) {
+            sched_yield();
+        }
+        prod = rec[0];
+        seq = rec[1] | (unsigned int)rec[2] << 8 | (unsigned int)rec[3] << 16 | (unsigned int)rec[4] << 24;
+        size = rec[5];
+
+        /* a record is only ever seen whole. */
+        assert(bstm_stat(stm, &stat) == BSTM_OK);
+        assert(stat.used_size >= TEST_HEAD_SIZE + size);
+        assert(bstm_read(stm, rec, TEST_HEAD_SIZE + size) == BSTM_OK);
+
+        /* the records of a producer come in the order it wrote them. */
+        assert(prod < TEST_PRODUCERS);
+        assert(seq == next[prod]);
+        assert(size == (seq + prod) % 64);
+        for (i = 0; i < size; i++) {
+            assert(rec[TEST_HEAD_SIZE + i] == test_byte(prod, seq, i));
+        }
+        next[prod]++;
+    }
+
+    for (prod = 0; prod < TEST_PRODUCERS; prod++) {
+        assert(pthread_join(thread[prod], NULL) == 0);
+        assert(next[prod] == TEST_RECORDS);
+    }
+    assert(bstm_stat(stm, &stat) == BSTM_OK);
+    assert(stat.used_size == 0);
+    bstm_del(stm);
+
+    printf("test_mpsc: ok\n");
+
+    return 0;
+}
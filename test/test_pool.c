@@ -0,0 +1,198 @@
+/**
+ * threads drawing segments from one pool at once through chained and
+ * pool-lent byte streams, some deleted by another thread than the one that
+ * filled them, and pool-lent ring buffers given back on empty and on clear.
+ * 
+ * gcc -I.. ../bytestream.c test_pool.c -o test_pool -lpthread && ./test_pool
+*/
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bytestream.h"
+
+#define TEST_THREADS    8
+#define TEST_ROUNDS     2000
+#define TEST_STREAMS    8
+#define TEST_SEG_SIZE   64
+
+static bstm_pool_t *pool;
+
+/* byte streams handed from each thread to the next one. */
+static bstm_ctx_t *handoff[TEST_THREADS][TEST_STREAMS];
+static pthread_barrier_t barrier;
+
+/**
+ * @brief get a byte of the data of a byte stream.
+ * 
+ * @param id byte stream id.
+ * @param i position.
+*/
+static unsigned char test_byte(unsigned int id, unsigned int i) {
+    return (unsigned char)(id * 13 + i * 7 + i / 251);
+}
+
+/**
+ * @brief fill a byte stream, the size depending on its id.
+ * 
+ * @param stm context pointer.
+ * @param id byte stream id.
+*/
+static void test_fill(bstm_ctx_t *stm, unsigned int id) {
+    unsigned char buff[200];
+    unsigned int size;
+    unsigned int i;
+
+    size = 1 + id % 200;
+    for (i = 0; i < size; i++) {
+        buff[i] = test_byte(id, i);
+    }
+    assert(bstm_write(stm, buff, size) == BSTM_OK);
+}
+
+/**
+ * @brief read a byte stream back and check its data.
+ * 
+ * @param stm context pointer.
+ * @param id byte stream id.
+*/
+static void test_check(bstm_ctx_t *stm, unsigned int id) {
+    unsigned char buff[200];
+    unsigned int size;
+    unsigned int i;
+
+    size = 1 + id % 200;
+    assert(bstm_read(stm, buff, size) == BSTM_OK);
+    for (i = 0; i < size; i++) {
+        assert(buff[i] == test_byte(id, i));
+    }
+}
+
+/**
+ * @brief get the id of a byte stream, a lent ring buffer holds less data.
+ * 
+ * @param thread thread index.
+ * @param round round number.
+ * @param i byte stream index.
+*/
+static unsigned int test_id(unsigned int thread, unsigned int round, int i) {
+    unsigned int id;
+
+    id = thread * 1000003u + round * TEST_STREAMS + (unsigned int)i;
+
+    return i % 2 == 0 ? id : id % (TEST_SEG_SIZE - 1);
+}
+
+static void *run(void *arg) {
+    bstm_ctx_t *stm[TEST_STREAMS];
+    bstm_conf_t conf;
+    unsigned int self;
+    unsigned int prev;
+    unsigned int round;
+    int i;
+
+    self = (unsigned int)(size_t)arg;
+    prev = (self + TEST_THREADS - 1) % TEST_THREADS;
+    for (round = 0; round < TEST_ROUNDS; round++) {
+
+        /* hold several byte streams at once, so their segments interleave. */
+        for (i = 0; i < TEST_STREAMS; i++) {
+            memset(&conf, 0, sizeof(conf));
+            conf.pool = pool;
+            conf.flags = i % 2 == 0 ? BSTM_CONF_CHAIN : 0;
+            assert(bstm_new(&stm[i], &conf) == BSTM_OK);
+            test_fill(stm[i], test_id(self, round, i));
+        }
+        for (i = 0; i < TEST_STREAMS; i++) {
+            test_check(stm[i], test_id(self, round, i));
+        }
+
+        /* every few rounds, the next thread reads and deletes them. */
+        if (round % 100 == 0) {
+            for (i = 0; i < TEST_STREAMS; i++) {
+                test_fill(stm[i], test_id(self, round, i));
+                handoff[self][i] = stm[i];
+            }
+            pthread_barrier_wait(&barrier);
+            for (i = 0; i < TEST_STREAMS; i++) {
+                test_check(handoff[prev][i], test_id(prev, round, i));
+                bstm_del(handoff[prev][i]);
+            }
+            pthread_barrier_wait(&barrier);
+        } else {
+            for (i = 0; i < TEST_STREAMS; i++) {
+                bstm_del(stm[i]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief get where the data of a pool-lent byte stream lives.
+ * 
+ * @param stm context pointer.
+*/
+static const bstm_u8_t *test_buff(bstm_ctx_t *stm) {
+    bstm_cspan_t span[2];
+
+    assert(bstm_read_acquire(stm, span, 1) == BSTM_OK);
+
+    return span[0].data;
+}
+
+int main(void) {
+    pthread_t thread[TEST_THREADS];
+    const bstm_u8_t *buff;
+    bstm_ctx_t *stm[2];
+    bstm_conf_t conf;
+    bstm_stat_t stat;
+    unsigned char byte;
+    int i;
+
+    assert(bstm_pool_new(&pool, TEST_SEG_SIZE) == BSTM_OK);
+
+    /* the capacity of a lent ring buffer comes from the segment size. */
+    memset(&conf, 0, sizeof(conf));
+    conf.pool = pool;
+    assert(bstm_new(&stm[0], &conf) == BSTM_OK);
+    assert(bstm_new(&stm[1], &conf) == BSTM_OK);
+    assert(bstm_stat(stm[0], &stat) == BSTM_OK);
+    assert(stat.cap_size == TEST_SEG_SIZE - 1);
+
+    /* read empty, the segment goes to the next borrower. */
+    assert(bstm_write(stm[0], "a", 1) == BSTM_OK);
+    buff = test_buff(stm[0]);
+    assert(bstm_read(stm[0], &byte, 1) == BSTM_OK);
+    assert(bstm_write(stm[1], "b", 1) == BSTM_OK);
+    assert(test_buff(stm[1]) == buff);
+
+    /* so it does when cleared. */
+    assert(bstm_clear(stm[1]) == BSTM_OK);
+    assert(bstm_write(stm[0], "c", 1) == BSTM_OK);
+    assert(test_buff(stm[0]) == buff);
+    assert(bstm_read(stm[0], &byte, 1) == BSTM_OK);
+    assert(byte == 'c');
+
+    bstm_del(stm[1]);
+    bstm_del(stm[0]);
+
+    /* many threads, many byte streams, one pool. */
+    assert(pthread_barrier_init(&barrier, NULL, TEST_THREADS) == 0);
+    for (i = 0; i < TEST_THREADS; i++) {
+        assert(pthread_create(&thread[i], NULL, run, (void *)(size_t)i) == 0);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        assert(pthread_join(thread[i], NULL) == 0);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    bstm_pool_del(pool);
+
+    printf("test_pool: ok\n");
+
+    return 0;
+}
@@ -0,0 +1,194 @@
+/**
+ * a producer and a consumer thread exchanging data in SPSC mode, through
+ * bstm_write() and bstm_write_reserve()/bstm_write_commit() on one side and
+ * bstm_read(), bstm_read_acquire()/bstm_read_release() and bstm_readline()
+ * on the other, wrapping around the ring buffer.
+ * 
+ * gcc -DBSTM_SPSC -I.. ../bytestream.c test_spsc.c -o test_spsc -lpthread && ./test_spsc
+*/
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bytestream.h"
+
+#ifndef BSTM_SPSC
+#error "build with -DBSTM_SPSC."
+#endif
+
+#define TEST_SIZE   1000000
+#define TEST_LINES  50000
+
+static bstm_ctx_t *stm;
+
+/**
+ * @brief get the byte at a position of the data sent.
+ * 
+ * @param i position.
+*/
+static unsigned char test_byte(unsigned int i) {
+    return (unsigned char)(i * 7 + i / 251);
+}
+
+static void *produce_bytes(void *arg) {
+    unsigned char buff[300];
+    bstm_span_t span[2];
+    unsigned int sent;
+    unsigned int size;
+    unsigned int i;
+
+    (void)arg;
+
+    for (sent = 0; sent < TEST_SIZE; ) {
+        size = 1 + sent % 293;
+        if (size > TEST_SIZE - sent) {
+            size = TEST_SIZE - sent;
+        }
+
+        /* every other chunk is written in place. */
+        if ((sent / 293) % 2 == 0) {
+            for (i = 0; i < size; i++) {
+                buff[i] = test_byte(sent + i);
+            }
+            if (bstm_write(stm, buff, size) != BSTM_OK) {
+                sched_yield();
+                continue;
+            }
+        } else {
+            if (bstm_write_reserve(stm, span, 0) != BSTM_OK) {
+                sched_yield();
+                continue;
+            }
+            if (size > span[0].size + span[1].size) {
+                size = span[0].size + span[1].size;
+            }
+            for (i = 0; i < size; i++) {
+                if (i < span[0].size) {
+                    span[0].data[i] = test_byte(sent + i);
+                } else {
+                    span[1].data[i - span[0].size] = test_byte(sent + i);
+                }
+            }
+            assert(bstm_write_commit(stm, size) == BSTM_OK);
+        }
+        sent += size;
+    }
+
+    return NULL;
+}
+
+static void consume_bytes(void) {
+    unsigned char buff[300];
+    bstm_cspan_t span[2];
+    unsigned int recv;
+    unsigned int size;
+    unsigned int i;
+
+    for (recv = 0; recv < TEST_SIZE; ) {
+
+        /* every other chunk is read in place. */
+        if ((recv / 211) % 2 == 0) {
+            size = 1 + recv % 211;
+            if (size > TEST_SIZE - recv) {
+                size = TEST_SIZE - recv;
+            }
+            if (bstm_read(stm, buff, size) != BSTM_OK) {
+                sched_yield();
+                continue;
+            }
+            for (i = 0; i < size; i++) {
+                assert(buff[i] == test_byte(recv + i));
+            }
+        } else {
+            if (bstm_read_acquire(stm, span, 0) != BSTM_OK) {
+                sched_yield();
+                continue;
+            }
+            size = span[0].size + span[1].size;
+            for (i = 0; i < size; i++) {
+                if (i < span[0].size) {
+                    assert(span[0].data[i] == test_byte(recv + i));
+                } else {
+                    assert(span[1].data[i - span[0].size] == test_byte(recv + i));
+                }
+            }
+            assert(bstm_read_release(stm, size) == BSTM_OK);
+        }
+        recv += size;
+    }
+}
+
+static void *produce_lines(void *arg) {
+    char line[64];
+    unsigned int n;
+    int len;
+
+    (void)arg;
+
+    for (n = 0; n < TEST_LINES; ) {
+
+        /* lines of every length, so they end at every offset. */
+        len = snprintf(line, sizeof(line), "%u %.*s\r\n", n, (int)(n % 40), "........................................");
+        if (bstm_write(stm, line, (bstm_size_t)len) != BSTM_OK) {
+            sched_yield();
+            continue;
+        }
+        n++;
+    }
+
+    return NULL;
+}
+
+static void consume_lines(void) {
+    char expect[64];
+    char line[64];
+    bstm_size_t len;
+    unsigned int n;
+    int expect_len;
+
+    for (n = 0; n < TEST_LINES; ) {
+        if (bstm_readline(stm, line, sizeof(line), &len) != BSTM_OK) {
+            sched_yield();
+            continue;
+        }
+        expect_len = snprintf(expect, sizeof(expect), "%u %.*s\r\n", n, (int)(n % 40), "........................................");
+        assert(len == (bstm_size_t)expect_len);
+        assert(memcmp(line, expect, len) == 0);
+        n++;
+    }
+}
+
+int main(void) {
+    bstm_conf_t conf;
+    bstm_stat_t stat;
+    pthread_t thread;
+    int pass;
+
+    for (pass = 0; pass < 2; pass++) {
+
+        /* an odd capacity wraps at odd offsets, a power of two is masked. */
+        memset(&conf, 0, sizeof(conf));
+        conf.cap_size = pass == 0 ? 777 : 1024;
+        conf.flags = pass == 0 ? 0 : BSTM_CONF_POW2;
+        assert(bstm_new(&stm, &conf) == BSTM_OK);
+
+        assert(pthread_create(&thread, NULL, produce_bytes, NULL) == 0);
+        consume_bytes();
+        assert(pthread_join(thread, NULL) == 0);
+
+        assert(pthread_create(&thread, NULL, produce_lines, NULL) == 0);
+        consume_lines();
+        assert(pthread_join(thread, NULL) == 0);
+
+        assert(bstm_stat(stm, &stat) == BSTM_OK);
+        assert(stat.used_size == 0);
+        bstm_del(stm);
+    }
+
+    printf("test_spsc: ok\n");
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * round trip through a socketpair with the io_uring engine, wrapping around
+ * the ring buffer. skipped where io_uring isn't available.
+ * 
+ * gcc -I.. ../bytestream.c ../bytestream_uring.c test_uring.c -o test_uring && ./test_uring
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bytestream.h"
+#include "bytestream_uring.h"
+
+#define TEST_SIZE   100000
+
+static unsigned char send_buff[TEST_SIZE];
+static unsigned char recv_buff[TEST_SIZE];
+
+int main(void) {
+    bstm_uring_event_t event[4];
+    bstm_uring_conf_t uconf;
+    bstm_uring_t *ring;
+    bstm_ctx_t *stm;
+    bstm_conf_t conf;
+    bstm_u32_t slot;
+    bstm_u32_t busy;
+    bstm_u32_t cnt;
+    bstm_u32_t i;
+    bstm_res_t res;
+    size_t send_size;
+    size_t recv_size;
+    ssize_t ret;
+    int fds[2];
+
+    for (i = 0; i < TEST_SIZE; i++) {
+        send_buff[i] = (unsigned char)(i * 13 + i / 509);
+    }
+
+    /* the limits are checked. */
+    uconf.sq_size = 8;
+    uconf.max_stms = 0;
+    assert(bstm_uring_new(&ring, &uconf) == BSTM_ERR);
+    uconf.max_stms = 16385;
+    assert(bstm_uring_new(&ring, &uconf) == BSTM_ERR);
+    uconf.sq_size = 0;
+    uconf.max_stms = 4;
+    assert(bstm_uring_new(&ring, &uconf) == BSTM_ERR);
+
+    uconf.sq_size = 8;
+    res = bstm_uring_new(&ring, &uconf);
+    if (res == BSTM_ERR_IO &&
+        (errno == ENOSYS || errno == EPERM)) {
+        printf("test_uring: skipped, no io_uring\n");
+
+        return 0;
+    }
+    assert(res == BSTM_OK);
+
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    assert(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 777;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+    assert(bstm_uring_attach(ring, stm, stm, &slot) == BSTM_OK);
+
+    /* fds[1] -> fds[0] -> byte stream -> fds[0] -> fds[1], one fill and one
+       drain in flight at most. a fill may wait for data that is still to be
+       written, so completions are polled rather than waited for. */
+    send_size = 0;
+    recv_size = 0;
+    busy = 0;
+    while (recv_size < TEST_SIZE) {
+        if (send_size < TEST_SIZE) {
+            ret = write(fds[1], send_buff + send_size, TEST_SIZE - send_size);
+            if (ret > 0) {
+                send_size += (size_t)ret;
+            }
+        }
+
+        if ((busy & (1u << BSTM_URING_FILL)) == 0 &&
+            bstm_uring_fill(ring, slot, fds[0]) == BSTM_OK) {
+            busy |= 1u << BSTM_URING_FILL;
+        }
+        if ((busy & (1u << BSTM_URING_DRAIN)) == 0 &&
+            bstm_uring_drain(ring, slot, fds[0]) == BSTM_OK) {
+            busy |= 1u << BSTM_URING_DRAIN;
+        }
+
+        assert(bstm_uring_submit(ring, 0) == BSTM_OK);
+        assert(bstm_uring_reap(ring, event, 4, &cnt) == BSTM_OK);
+        for (i = 0; i < cnt; i++) {
+            assert(event[i].ctx == stm);
+            assert(event[i].user == stm);
+            assert(event[i].res > 0);
+            busy &= ~(1u << event[i].op);
+        }
+
+        ret = read(fds[1], recv_buff + recv_size, TEST_SIZE - recv_size);
+        if (ret > 0) {
+            recv_size += (size_t)ret;
+        }
+    }
+    assert(memcmp(send_buff, recv_buff, TEST_SIZE) == 0);
+
+    /* end the data so the last fill completes, then wait for the I/O still
+       in flight before tearing down. */
+    assert(shutdown(fds[1], SHUT_WR) == 0);
+    while (busy != 0) {
+        assert(bstm_uring_submit(ring, 1) == BSTM_OK);
+        assert(bstm_uring_reap(ring, event, 4, &cnt) == BSTM_OK);
+        for (i = 0; i < cnt; i++) {
+            busy &= ~(1u << event[i].op);
+        }
+    }
+
+    assert(bstm_uring_detach(ring, slot) == BSTM_OK);
+    assert(bstm_uring_del(ring) == BSTM_OK);
+    bstm_del(stm);
+    close(fds[0]);
+    close(fds[1]);
+
+    printf("test_uring: ok\n");
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+/**
+ * bstm_read_wait(), bstm_readline_wait() and bstm_write_wait() timing out,
+ * only checking with a timeout of 0, and woken by the other side on another
+ * thread. futex system calls are counted, so a waiter done waiting is seen
+ * to take its bit back instead of leaving the other side waking nobody.
+ * 
+ * gcc -DBSTM_WAIT -I.. ../bytestream.c test_wait.c -o test_wait -lpthread -ldl && ./test_wait
+*/
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <dlfcn.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bytestream.h"
+
+#ifndef BSTM_WAIT
+#error "build with -DBSTM_WAIT."
+#endif
+
+static bstm_ctx_t *stm;
+static int wake_cnt;
+
+/**
+ * @brief count the futex wakes made by the byte stream, then make the call.
+ * 
+ * @param number system call number.
+*/
+long syscall(long number, ...) {
+    static long (*next)(long, ...);
+    long arg[6];
+    va_list ap;
+    int i;
+
+    va_start(ap, number);
+    for (i = 0; i < 6; i++) {
+        arg[i] = va_arg(ap, long);
+    }
+    va_end(ap);
+
+    if (number == SYS_futex &&
+        (arg[1] & FUTEX_CMD_MASK) == FUTEX_WAKE) {
+        __atomic_fetch_add(&wake_cnt, 1, __ATOMIC_RELAXED);
+    }
+
+    if (next == NULL) {
+        next = (long (*)(long, ...))dlsym(RTLD_NEXT, "syscall");
+    }
+
+    return next(number, arg[0], arg[1], arg[2], arg[3], arg[4], arg[5]);
+}
+
+/**
+ * @brief get a monotonic time in milliseconds.
+*/
+static long test_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void *write_later(void *arg) {
+    usleep(20000);
+    assert(bstm_write(stm, (const char *)arg, (bstm_size_t)strlen((const char *)arg)) == BSTM_OK);
+
+    return NULL;
+}
+
+static void *read_later(void *arg) {
+    unsigned char buff[8];
+
+    (void)arg;
+
+    usleep(20000);
+    assert(bstm_read(stm, buff, 8) == BSTM_OK);
+
+    return NULL;
+}
+
+int main(void) {
+    unsigned char buff[16];
+    pthread_t thread;
+    bstm_conf_t conf;
+    bstm_size_t len;
+    long start;
+
+    memset(&conf, 0, sizeof(conf));
+    conf.cap_size = 16;
+    assert(bstm_new(&stm, &conf) == BSTM_OK);
+
+    /* a timeout of 0 only checks. */
+    assert(bstm_read_wait(stm, 1, 0) == BSTM_ERR_TIMEOUT);
+    assert(bstm_readline_wait(stm, 0) == BSTM_ERR_TIMEOUT);
+    assert(bstm_write_wait(stm, 16, 0) == BSTM_OK);
+    assert(bstm_write_wait(stm, 17, 0) == BSTM_ERR_BAD_SIZE);
+
+    /* a timed out wait takes its time. */
+    start = test_now();
+    assert(bstm_read_wait(stm, 1, 50) == BSTM_ERR_TIMEOUT);
+    assert(test_now() - start >= 45);
+
+    /* neither an only checking nor a timed out waiter is left to wake. */
+    wake_cnt = 0;
+    assert(bstm_write(stm, "a", 1) == BSTM_OK);
+    assert(bstm_read(stm, buff, 1) == BSTM_OK);
+    assert(wake_cnt == 0);
+
+    /* data written on another thread wakes the consumer. */
+    assert(pthread_create(&thread, NULL, write_later, "abc") == 0);
+    assert(bstm_read_wait(stm, 3, -1) == BSTM_OK);
+    assert(pthread_join(thread, NULL) == 0);
+    assert(bstm_read(stm, buff, 3) == BSTM_OK);
+    assert(memcmp(buff, "abc", 3) == 0);
+
+    /* so does the end of a line, and the woken waiter takes its bit back. */
+    assert(bstm_write(stm, "ab", 2) == BSTM_OK);
+    assert(pthread_create(&thread, NULL, write_later, "c\r\n") == 0);
+    assert(bstm_readline_wait(stm, 1000) == BSTM_OK);
+    assert(pthread_join(thread, NULL) == 0);
+    assert(bstm_readline(stm, buff, sizeof(buff), &len) == BSTM_OK);
+    assert(len == 5);
+    assert(memcmp(buff, "abc\r\n", 5) == 0);
+    wake_cnt = 0;
+    assert(bstm_write(stm, "a", 1) == BSTM_OK);
+    assert(wake_cnt == 0);
+    assert(bstm_read(stm, buff, 1) == BSTM_OK);
+
+    /* space freed on another thread wakes the producer. */
+    assert(bstm_write(stm, "0123456789abcdef", 16) == BSTM_OK);
+    assert(bstm_write_wait(stm, 1, 0) == BSTM_ERR_TIMEOUT);
+    assert(pthread_create(&thread, NULL, read_later, NULL) == 0);
+    assert(bstm_write_wait(stm, 8, -1) == BSTM_OK);
+    assert(pthread_join(thread, NULL) == 0);
+    assert(bstm_write(stm, "ghijklmn", 8) == BSTM_OK);
+    assert(bstm_read(stm, buff, 16) == BSTM_OK);
+    assert(memcmp(buff, "89abcdefghijklmn", 16) == 0);
+
+    bstm_del(stm);
+
+    printf("test_wait: ok\n");
+
+    return 0;
+}